@@ -105,6 +105,7 @@
 #define SSD_SIZE				(BLOCK_NUM_PER_SSD * BLOCK_SIZE_MB) //MB
 #define FREE_BLOCK_SIZE			(DIE_NUM * BLOCK_SIZE_MB)			//MB
 #define METADATA_BLOCK_SIZE		(DIE_NUM * BLOCK_SIZE_MB)			//MB
+#define TRANS_WARM_BLOCK_SIZE	(DIE_NUM * BLOCK_SIZE_MB)			//MB, embedding cache checkpoint (trans_warm.h)
 #define OVER_PROVISION_BLOCK_SIZE		((BLOCK_NUM_PER_SSD / 20) * BLOCK_SIZE_MB)	//MB
 
 #define BAD_BLOCK_MARK_LOCATION1	0 			//first byte of data region
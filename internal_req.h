@@ -89,7 +89,8 @@ typedef struct _LOW_LEVEL_REQ_INFO
 	unsigned int request : 16;
   	unsigned int transBufferEntry : 8;
 	unsigned int translate : 1;
-	unsigned int reserved : 23;
+	unsigned int transMshr : 8; // MSHR of the read on its die, if translate
+	unsigned int reserved : 15;
 	unsigned int transPageIdx;
 }LOW_LEVEL_REQ_INFO, *P_LOW_LEVEL_REQ_INFO;
 
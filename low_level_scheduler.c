@@ -81,6 +81,7 @@
 #include "memory_map.h"
 #include "nvme/host_lld.h"
 #include "nvme/debug.h"
+#include "xil_cache.h"
 #include <assert.h>
 
 struct reqArray* reqQueue;
@@ -184,6 +185,7 @@ int PushToReqQueueNonBlocking(P_LOW_LEVEL_REQ_INFO lowLevelCmd, unsigned int ope
 		reqQueue->reqEntry[rear][chNo][wayNo].transBufferEntry = lowLevelCmd->transBufferEntry;
 		reqQueue->reqEntry[rear][chNo][wayNo].translate = lowLevelCmd->translate;
 		reqQueue->reqEntry[rear][chNo][wayNo].transPageIdx = lowLevelCmd->transPageIdx;
+		reqQueue->reqEntry[rear][chNo][wayNo].transMshr = lowLevelCmd->transMshr;
 		reqQueue->reqEntry[rear][chNo][wayNo].pageDataBuf = BUFFER_ADDR + lowLevelCmd->bufferEntry * BUF_ENTRY_SIZE;
 		reqQueue->reqEntry[rear][chNo][wayNo].spareDataBuf = lowLevelCmd->spareDataBuf;
 		reqQueue->reqEntry[rear][chNo][wayNo].statusOption = STATUS_CHECK;
@@ -221,7 +223,12 @@ void PushToTransReqQueue(unsigned int entryIdx)
 	transReqQueue->transReqEntry[slot].nextPage = 0;
 }
 
-void PushToTransReadReqQueue(unsigned int entryIdx, unsigned int cmdSlotTag, unsigned int nlb)
+/*
+ * Queue a read of the next nlb result sectors of a request. They are sent to
+ * the command's data buffer starting dmaOffset sectors in.
+ */
+void PushToTransReadReqQueue(unsigned int entryIdx, unsigned int cmdSlotTag, unsigned int nlb, unsigned int dmaOffset,
+		XTime requested)
 {
 	while (transReadRqPointer->availhead == 0xffff)
 		ExeLowLevelReq(SUB_REQ_QUEUE);
@@ -245,14 +252,34 @@ void PushToTransReadReqQueue(unsigned int entryIdx, unsigned int cmdSlotTag, uns
 	}
 
 	transReadReqQueue->transReqEntry[slot].entryIdx = entryIdx;
-	transReadReqQueue->transReqEntry[slot].firstSector = transMap->bufEntry[entryIdx].nlbRequested;
+	// Result sector which would go to DMA index 0 (unsigned, may precede the request's first)
+	transReadReqQueue->transReqEntry[slot].firstSector = transMap->bufEntry[entryIdx].nlbRequested - dmaOffset;
 	transReadReqQueue->transReqEntry[slot].nextSector = transMap->bufEntry[entryIdx].nlbRequested;
 	transReadReqQueue->transReqEntry[slot].cmdSlotTag = cmdSlotTag;
 	transReadReqQueue->transReqEntry[slot].nlb = nlb;
+	transReadReqQueue->transReqEntry[slot].requested = requested;
+	transReadReqQueue->transReqEntry[slot].exact = 0;
 
 	transMap->bufEntry[entryIdx].nlbRequested += nlb;
 }
 
+// Queue a read of all results of a request, sent at their exact length to the given PRPs
+void PushToTransExactReadReqQueue(unsigned int entryIdx, unsigned int cmdSlotTag, const unsigned int* prp, XTime requested)
+{
+	PushToTransReadReqQueue(entryIdx, cmdSlotTag, 0, 0, requested);
+
+	unsigned int slot = transReadRqPointer->tail;
+	transReadReqQueue->transReqEntry[slot].exact = 1;
+	transReadReqQueue->transReqEntry[slot].prp[0] = prp[0];
+	transReadReqQueue->transReqEntry[slot].prp[1] = prp[1];
+	transReadReqQueue->transReqEntry[slot].prp[2] = prp[2];
+	transReadReqQueue->transReqEntry[slot].prp[3] = prp[3];
+	transReadReqQueue->transReqEntry[slot].prpList = 0;
+
+	// The request is kept until the read is done, see AdvanceTransChain
+	transMap->bufEntry[entryIdx].exactRead = 1;
+}
+
 int PopFromTransReqQueue()
 {
 	if (transRqPointer->head == 0xffff) return 0;
@@ -312,15 +339,32 @@ int PopFromTransReadReqQueue()
 {
 	if (transReadRqPointer->head == 0xffff) return 0;
 
-	int nlbReturned = readTranslatedPagesNonBlocking(
-			transReadReqQueue->transReqEntry[transReadRqPointer->current].entryIdx,
-			transReadReqQueue->transReqEntry[transReadRqPointer->current].firstSector,
-			transReadReqQueue->transReqEntry[transReadRqPointer->current].nextSector,
-			transReadReqQueue->transReqEntry[transReadRqPointer->current].nlb,
-			transReadReqQueue->transReqEntry[transReadRqPointer->current].cmdSlotTag);
-	transReadReqQueue->transReqEntry[transReadRqPointer->current].nlb -= nlbReturned;
-	transReadReqQueue->transReqEntry[transReadRqPointer->current].nextSector += nlbReturned;
-	int pop = !transReadReqQueue->transReqEntry[transReadRqPointer->current].nlb;
+	int pop;
+	if (transReadReqQueue->transReqEntry[transReadRqPointer->current].exact)
+	{
+		pop = returnTranslatedResultsNonBlocking(&transReadReqQueue->transReqEntry[transReadRqPointer->current]);
+	}
+	else
+	{
+		int nlbReturned = readTranslatedPagesNonBlocking(
+				transReadReqQueue->transReqEntry[transReadRqPointer->current].entryIdx,
+				transReadReqQueue->transReqEntry[transReadRqPointer->current].firstSector,
+				transReadReqQueue->transReqEntry[transReadRqPointer->current].nextSector,
+				transReadReqQueue->transReqEntry[transReadRqPointer->current].nlb,
+				transReadReqQueue->transReqEntry[transReadRqPointer->current].cmdSlotTag,
+				transReadReqQueue->transReqEntry[transReadRqPointer->current].requested);
+		if (nlbReturned < 0)
+		{
+			// Failed, see readTranslatedPagesNonBlocking
+			pop = 1;
+		}
+		else
+		{
+			transReadReqQueue->transReqEntry[transReadRqPointer->current].nlb -= nlbReturned;
+			transReadReqQueue->transReqEntry[transReadRqPointer->current].nextSector += nlbReturned;
+			pop = !transReadReqQueue->transReqEntry[transReadRqPointer->current].nlb;
+		}
+	}
 
 	if (pop)
 	{
@@ -365,17 +409,18 @@ int CheckTransConfigDMA(unsigned int bufferEntry)
 {
 	if(transMap->bufEntry[bufferEntry].rxDmaExe)
 	{
-	  if(check_auto_rx_dma_partial_done(transMap->bufEntry[bufferEntry].rxDmaTail, transMap->bufEntry[bufferEntry].rxDmaOverFlowCnt))
-	  {
-		transMap->bufEntry[bufferEntry].rxDmaExe = 0;
+	  if(!check_auto_rx_dma_partial_done(transMap->bufEntry[bufferEntry].rxDmaTail, transMap->bufEntry[bufferEntry].rxDmaOverFlowCnt))
+		return 0;
+
+	  transMap->bufEntry[bufferEntry].rxDmaExe = 0;
 
-		/* Initialize map entry with config info now that it's back. */
-		ConfigureTransBufEntry(bufferEntry);
-		return 1;
-	  }
+	  // Lines may have been speculatively filled while the DMA was running
+	  Xil_DCacheInvalidateRange(transMap->bufEntry[bufferEntry].configAddr, transMap->bufEntry[bufferEntry].configBytes);
 	}
 
-	return 0;
+	/* Initialize map entry with config info now that it's back, retried until the arena has room
+	 * and called again each pass until the ID list is walked (TRANS_CONFIG_SLICE). */
+	return ConfigureTransBufEntry(bufferEntry);
 }
 
 int CheckDMA(int chNo, int wayNo)
@@ -838,9 +883,10 @@ int ExeLowLevelReqPerDie(int chNo, int wayNo, int reqStatus)
 				{
 					if (transPageReqQueue->transPageReqEntry[chNo][wayNo].valid)
 					{
-						translatePage(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
+						CompleteTransPageRead(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
 								(void*)transPageReqQueue->transPageReqEntry[chNo][wayNo].pageDataBuf,
-							transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx);
+							transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx, chNo + wayNo * CHANNEL_NUM,
+							transPageReqQueue->transPageReqEntry[chNo][wayNo].transMshr);
 						transPageReqQueue->transPageReqEntry[chNo][wayNo].valid = 0;
 					}
 				}
@@ -866,9 +912,10 @@ int ExeLowLevelReqPerDie(int chNo, int wayNo, int reqStatus)
 				{
 					if (transPageReqQueue->transPageReqEntry[chNo][wayNo].valid)
 					{
-						translatePage(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
+						CompleteTransPageRead(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
 								(void*)transPageReqQueue->transPageReqEntry[chNo][wayNo].pageDataBuf,
-							transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx);
+							transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx, chNo + wayNo * CHANNEL_NUM,
+							transPageReqQueue->transPageReqEntry[chNo][wayNo].transMshr);
 						transPageReqQueue->transPageReqEntry[chNo][wayNo].valid = 0;
 					}
 					transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry =
@@ -877,6 +924,8 @@ int ExeLowLevelReqPerDie(int chNo, int wayNo, int reqStatus)
 							reqQueue->reqEntry[front][chNo][wayNo].pageDataBuf;
 					transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx =
 							reqQueue->reqEntry[front][chNo][wayNo].transPageIdx;
+					transPageReqQueue->transPageReqEntry[chNo][wayNo].transMshr =
+							reqQueue->reqEntry[front][chNo][wayNo].transMshr;
 					transPageReqQueue->transPageReqEntry[chNo][wayNo].valid = 1;
 					rqPointer->rqPointerEntry[chNo][wayNo].front = (rqPointer->rqPointerEntry[chNo][wayNo].front + 1) % REQ_QUEUE_DEPTH;
 				}
@@ -945,9 +994,10 @@ int ExeLowLevelReqPerDie(int chNo, int wayNo, int reqStatus)
 			else if(reqStatus == RS_RUNNING) {
 				if (transPageReqQueue->transPageReqEntry[chNo][wayNo].valid)
 				{
-					translatePage(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
+					CompleteTransPageRead(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
 							(void*)transPageReqQueue->transPageReqEntry[chNo][wayNo].pageDataBuf,
-						transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx);
+						transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx, chNo + wayNo * CHANNEL_NUM,
+						transPageReqQueue->transPageReqEntry[chNo][wayNo].transMshr);
 					transPageReqQueue->transPageReqEntry[chNo][wayNo].valid = 0;
 				}
 				break;
@@ -1015,9 +1065,10 @@ int ExeLowLevelReqPerDie(int chNo, int wayNo, int reqStatus)
 				{
 					if (transPageReqQueue->transPageReqEntry[chNo][wayNo].valid)
 					{
-						translatePage(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
+						CompleteTransPageRead(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
 								(void*)transPageReqQueue->transPageReqEntry[chNo][wayNo].pageDataBuf,
-							transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx);
+							transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx, chNo + wayNo * CHANNEL_NUM,
+							transPageReqQueue->transPageReqEntry[chNo][wayNo].transMshr);
 						transPageReqQueue->transPageReqEntry[chNo][wayNo].valid = 0;
 					}
 					transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry =
@@ -1026,6 +1077,8 @@ int ExeLowLevelReqPerDie(int chNo, int wayNo, int reqStatus)
 							reqQueue->reqEntry[front][chNo][wayNo].pageDataBuf;
 					transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx =
 							reqQueue->reqEntry[front][chNo][wayNo].transPageIdx;
+					transPageReqQueue->transPageReqEntry[chNo][wayNo].transMshr =
+							reqQueue->reqEntry[front][chNo][wayNo].transMshr;
 					transPageReqQueue->transPageReqEntry[chNo][wayNo].valid = 1;
 					rqPointer->rqPointerEntry[chNo][wayNo].front = (rqPointer->rqPointerEntry[chNo][wayNo].front + 1) % REQ_QUEUE_DEPTH;
 				}
@@ -1094,9 +1147,10 @@ int ExeLowLevelReqPerDie(int chNo, int wayNo, int reqStatus)
 			else if(reqStatus == RS_RUNNING) {
 				if (transPageReqQueue->transPageReqEntry[chNo][wayNo].valid)
 				{
-					translatePage(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
+					CompleteTransPageRead(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
 							(void*)transPageReqQueue->transPageReqEntry[chNo][wayNo].pageDataBuf,
-						transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx);
+						transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx, chNo + wayNo * CHANNEL_NUM,
+						transPageReqQueue->transPageReqEntry[chNo][wayNo].transMshr);
 					transPageReqQueue->transPageReqEntry[chNo][wayNo].valid = 0;
 				}
 				break;
@@ -1541,9 +1595,10 @@ int ExeLowLevelReqPerCh(int chNo, int firstQueue)
 			for(wayNo = 0; wayNo < WAY_NUM; wayNo++) {
 				if (transPageReqQueue->transPageReqEntry[chNo][wayNo].valid)
 				{
-					translatePage(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
+					CompleteTransPageRead(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
 							(void*)transPageReqQueue->transPageReqEntry[chNo][wayNo].pageDataBuf,
-						transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx);
+						transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx, chNo + wayNo * CHANNEL_NUM,
+						transPageReqQueue->transPageReqEntry[chNo][wayNo].transMshr);
 					transPageReqQueue->transPageReqEntry[chNo][wayNo].valid = 0;
 				}
 			}
@@ -1726,9 +1781,10 @@ int ExeLowLevelReqPerCh(int chNo, int firstQueue)
 						for(wayNo = 0; wayNo < WAY_NUM; wayNo++) {
 							if (transPageReqQueue->transPageReqEntry[chNo][wayNo].valid)
 							{
-								translatePage(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
+								CompleteTransPageRead(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
 										(void*)transPageReqQueue->transPageReqEntry[chNo][wayNo].pageDataBuf,
-									transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx);
+									transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx, chNo + wayNo * CHANNEL_NUM,
+									transPageReqQueue->transPageReqEntry[chNo][wayNo].transMshr);
 								transPageReqQueue->transPageReqEntry[chNo][wayNo].valid = 0;
 								return 1;
 							}
@@ -1773,9 +1829,10 @@ int ExeLowLevelReqPerCh(int chNo, int firstQueue)
 					for(wayNo = 0; wayNo < WAY_NUM; wayNo++) {
 						if (transPageReqQueue->transPageReqEntry[chNo][wayNo].valid)
 						{
-							translatePage(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
+							CompleteTransPageRead(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
 									(void*)transPageReqQueue->transPageReqEntry[chNo][wayNo].pageDataBuf,
-								transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx);
+								transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx, chNo + wayNo * CHANNEL_NUM,
+								transPageReqQueue->transPageReqEntry[chNo][wayNo].transMshr);
 							transPageReqQueue->transPageReqEntry[chNo][wayNo].valid = 0;
 							return 1;
 						}
@@ -1820,9 +1877,10 @@ int ExeLowLevelReqPerCh(int chNo, int firstQueue)
 					for(wayNo = 0; wayNo < WAY_NUM; wayNo++) {
 						if (transPageReqQueue->transPageReqEntry[chNo][wayNo].valid)
 						{
-							translatePage(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
+							CompleteTransPageRead(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
 									(void*)transPageReqQueue->transPageReqEntry[chNo][wayNo].pageDataBuf,
-								transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx);
+								transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx, chNo + wayNo * CHANNEL_NUM,
+								transPageReqQueue->transPageReqEntry[chNo][wayNo].transMshr);
 							transPageReqQueue->transPageReqEntry[chNo][wayNo].valid = 0;
 							return 1;
 						}
@@ -1873,9 +1931,10 @@ int ExeLowLevelReqPerCh(int chNo, int firstQueue)
 						for(wayNo = 0; wayNo < WAY_NUM; wayNo++) {
 							if (transPageReqQueue->transPageReqEntry[chNo][wayNo].valid)
 							{
-								translatePage(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
+								CompleteTransPageRead(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
 										(void*)transPageReqQueue->transPageReqEntry[chNo][wayNo].pageDataBuf,
-									transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx);
+									transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx, chNo + wayNo * CHANNEL_NUM,
+									transPageReqQueue->transPageReqEntry[chNo][wayNo].transMshr);
 								transPageReqQueue->transPageReqEntry[chNo][wayNo].valid = 0;
 								return 1;
 							}
@@ -1927,9 +1986,10 @@ int ExeLowLevelReqPerCh(int chNo, int firstQueue)
 						for(wayNo = 0; wayNo < WAY_NUM; wayNo++) {
 							if (transPageReqQueue->transPageReqEntry[chNo][wayNo].valid)
 							{
-								translatePage(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
+								CompleteTransPageRead(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
 										(void*)transPageReqQueue->transPageReqEntry[chNo][wayNo].pageDataBuf,
-									transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx);
+									transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx, chNo + wayNo * CHANNEL_NUM,
+									transPageReqQueue->transPageReqEntry[chNo][wayNo].transMshr);
 								transPageReqQueue->transPageReqEntry[chNo][wayNo].valid = 0;
 								return 1;
 							}
@@ -1945,9 +2005,10 @@ int ExeLowLevelReqPerCh(int chNo, int firstQueue)
 	for(wayNo = 0; wayNo < WAY_NUM; wayNo++) {
 		if (transPageReqQueue->transPageReqEntry[chNo][wayNo].valid)
 		{
-			translatePage(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
+			CompleteTransPageRead(transPageReqQueue->transPageReqEntry[chNo][wayNo].transBufferEntry,
 					(void*)transPageReqQueue->transPageReqEntry[chNo][wayNo].pageDataBuf,
-				transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx);
+				transPageReqQueue->transPageReqEntry[chNo][wayNo].transPageIdx, chNo + wayNo * CHANNEL_NUM,
+				transPageReqQueue->transPageReqEntry[chNo][wayNo].transMshr);
 			transPageReqQueue->transPageReqEntry[chNo][wayNo].valid = 0;
 			return 1;
 		}
@@ -138,7 +138,8 @@ struct reqEntry {
 	unsigned int request : 16;
 	unsigned int translate : 1;
 	unsigned int transBufferEntry : 8;
-	unsigned int reserved : 23;
+	unsigned int transMshr : 8;
+	unsigned int reserved : 15;
 	unsigned int transPageIdx;
 };
 
@@ -151,6 +152,12 @@ struct transReqEntry {
 	unsigned int firstSector;
 	unsigned int nlb;
 	unsigned int cmdSlotTag;
+	XTime requested;
+
+	// Exact length reads (IO_TRANS_READ_EXACT) send bytes by direct DMA
+	unsigned int exact;
+	unsigned int prp[4]; // PRP1, PRP2 as low, high
+	unsigned int prpList; // fetched PRP list, 0 until needed
 
 	unsigned int prev : 16;
 	unsigned int next : 16;
@@ -172,6 +179,7 @@ struct transPageReqEntry {
 	unsigned int transBufferEntry;
 	unsigned int pageDataBuf;
 	unsigned int transPageIdx;
+	unsigned int transMshr;
 	unsigned int valid;
 };
 
@@ -274,7 +282,9 @@ int CheckReqStatusAsync(int chNo, int wayNo);
 int CheckReqErrorInfo(int chNo, int wayNo);
 
 void PushToTransReqQueue(unsigned int entryIdx);
-void PushToTransReadReqQueue(unsigned int entryIdx, unsigned int cmdSlotTag, unsigned int nlb);
+void PushToTransReadReqQueue(unsigned int entryIdx, unsigned int cmdSlotTag, unsigned int nlb, unsigned int dmaOffset,
+		XTime requested);
+void PushToTransExactReadReqQueue(unsigned int entryIdx, unsigned int cmdSlotTag, const unsigned int* prp, XTime requested);
 int PopFromTransReqQueue();
 int PopFromTransReadReqQueue();
 
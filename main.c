@@ -63,6 +63,7 @@
 #include "nvme/nvme.h"
 #include "nvme/nvme_main.h"
 #include "nvme/host_lld.h"
+#include "memory_map.h"
 
 
 XScuGic GicInstance;
@@ -86,14 +87,18 @@ int main()
 		// Doesn't fit with code in A9 RAM
 		// 16MB starts the ADMIN_CMD_BUFFER space
 		// 256MB starts the IO_BUFFER space
+		// 293MB starts the translation arena and embedding cache (TRANS_CACHED_ADDR)
 		// 422MB starts the FTL data structure space
 		// 900MB ends the available memory space
+		// 4095MB holds the upper 64KB of OCM (TRANS_EMBED_L1_ADDR)
 		if (u < 16)
 			Xil_SetTlbAttributes(u * MB, 0xC1E); // cached & buffered
-		else if (u < 422)
+		else if (u < TRANS_CACHED_ADDR / MB)
 			Xil_SetTlbAttributes(u * MB, 0xC12); // uncached & nonbuffered
 		else if (u < 900)
 			Xil_SetTlbAttributes(u * MB, 0xC1E); // cached & buffered
+		else if (u == TRANS_EMBED_L1_ADDR / MB)
+			Xil_SetTlbAttributes(u * MB, 0xC1E); // cached & buffered, OCM L1 of the embedding cache
 		else
 			Xil_SetTlbAttributes(u * MB, 0xC12); // uncached & nonbuffered
 
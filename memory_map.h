@@ -62,6 +62,10 @@
 
 #include "lru_buffer.h"
 #include "trans_buffer.h"
+#include "trans_cache.h"
+#include "trans_arena.h"
+#include "trans_registry.h"
+#include "trans_warm.h"
 #include "page_map.h"
 
 // Uncached & Unbuffered
@@ -71,14 +75,25 @@
 
 #define PAY_LOAD_ADDR	0x12300000
 
-#define TRANS_CONFIG_ADDR   0x12500000
-#define TRANS_BUF_ADDR      (TRANS_CONFIG_ADDR + TRANS_BUF_ENTRY_NUM * TRANS_CONFIG_SIZE)
-// End Trans Buf 0x13500000
+// Trans configs, results and request bookkeeping
+#define TRANS_ARENA_ADDR   0x12500000
 
-#define TRANS_EMBED_CACHE_ADDR (TRANS_BUF_ADDR + TRANS_BUF_ENTRY_NUM * TRANS_BUF_ENTRY_SIZE)
+/*
+ * Cached & buffered from the arena on (see main.c), the embedding cache is only
+ * touched by the CPU. Host DMAs into or out of the arena clean/invalidate the
+ * range themselves, see start_trans_config and readTranslatedPagesNonBlocking.
+ * Must be 1MB aligned.
+ */
+#define TRANS_CACHED_ADDR TRANS_ARENA_ADDR
+
+#define TRANS_EMBED_CACHE_ADDR (TRANS_ARENA_ADDR + TRANS_ARENA_SIZE)
+#define TRANS_EMBED_CACHE_TAG_ADDR (TRANS_EMBED_CACHE_ADDR + sizeof(struct transEmbedCache))
+
+// On-chip RAM (ps7_ram_1), cached & buffered (see main.c)
+#define TRANS_EMBED_L1_ADDR 0xFFFF0000
 
 // for buffers
-#define BUFFER_MAP_ADDR		 (TRANS_EMBED_CACHE_ADDR + sizeof(struct transEmbedCacheEntry) * TRANS_EMBED_CACHE_ENTRY_NUM)  // OLD -> 0x1A600000
+#define BUFFER_MAP_ADDR		 (TRANS_EMBED_CACHE_TAG_ADDR + sizeof(struct transEmbedCacheTagArray))  // OLD -> 0x1A600000
 #define BUFFER_LRU_LIST_ADDR 	(BUFFER_MAP_ADDR + sizeof(struct bufEntry) * BUF_ENTRY_NUM)
 #define TRANS_BUF_MAP_ADDR (BUFFER_LRU_LIST_ADDR + sizeof(struct bufLruEntry) * DIE_NUM)
 #define TRANS_AVAIL_Q_ADDR (TRANS_BUF_MAP_ADDR + sizeof(struct transBufEntry) * TRANS_BUF_ENTRY_NUM)
@@ -109,6 +124,15 @@
 #define WAY_PRIORITY_TABLE_ADDR (RETRY_LIMIT_TABLE_ADDR + sizeof(struct retryLimitArray))
 
 #define TRANS_STATS_ADDR (WAY_PRIORITY_TABLE_ADDR + sizeof(struct wayPriorityArray))
+#define TRANS_SORT_BUF_ADDR (TRANS_STATS_ADDR + sizeof(struct transStatistics))
+#define TRANS_DECODED_ROW_ADDR (TRANS_SORT_BUF_ADDR + TRANS_SORT_BUF_SIZE)
+#define TRANS_MSHR_ADDR (TRANS_DECODED_ROW_ADDR + TRANS_DECODED_ROW_SIZE)
+#define TRANS_ARENA_MAP_ADDR (TRANS_MSHR_ADDR + sizeof(struct transMshrTable))
+#define TRANS_ADMIT_Q_ADDR (TRANS_ARENA_MAP_ADDR + sizeof(struct transArenaMap))
+#define TRANS_TAG_TABLE_ADDR (TRANS_ADMIT_Q_ADDR + sizeof(struct transAdmitQueue))
+#define TRANS_REGISTRY_ADDR (TRANS_TAG_TABLE_ADDR + sizeof(struct transTagTable))
+// Flash pages are DMAed in and out, page aligned
+#define TRANS_WARM_ADDR ((TRANS_REGISTRY_ADDR + sizeof(struct transTableRegistry) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1))
 
 // for 0-3 flash channel (HP port 0)
 #define COMPLETE_TABLE_ADDR0		0x80000000
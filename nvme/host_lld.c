@@ -321,6 +321,11 @@ void set_direct_tx_dma(unsigned int devAddr, unsigned int pcieAddrH, unsigned in
 
 	ASSERT((len <= 0x1000) && ((pcieAddrL & 0x7) == 0));
 	
+	// The FIFO counters are 8 bits, keep fewer than 256 DMAs outstanding
+	g_hostDmaStatus.fifoHead.dword = IO_READ32(HOST_DMA_FIFO_CNT_REG_ADDR);
+	while((g_hostDmaStatus.fifoTail.directDmaTx + 1) % 256 == g_hostDmaStatus.fifoHead.directDmaTx)
+		g_hostDmaStatus.fifoHead.dword = IO_READ32(HOST_DMA_FIFO_CNT_REG_ADDR);
+
 	hostDmaReg.devAddr = devAddr;
 	hostDmaReg.pcieAddrL = pcieAddrL;
 	hostDmaReg.pcieAddrH = pcieAddrH;
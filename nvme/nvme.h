@@ -74,6 +74,7 @@
 #define ADMIN_FORMAT_NVM									0x80
 #define ADMIN_SECURITY_SEND									0x81
 #define ADMIN_SECURITY_RECEIVE								0x82
+#define ADMIN_EMBED_TABLE_REGISTER							0xC0 // vendor specific, no data
 
 /*Opcodes for IO Commands */
 #define IO_NVM_FLUSH										0x00
@@ -84,6 +85,35 @@
 #define IO_NVM_WRITE_UNCORRECTABLE							0x04
 #define IO_NVM_COMPARE										0x05
 #define IO_NVM_DATASET_MANAGEMENT							0x09
+#define IO_NVM_EMBED_PRELOAD								0x81 // vendor specific, host to controller
+#define IO_NVM_EMBED_TRANSLATE								0x83 // vendor specific, bidirectional
+
+/*
+ * Translation configs and result reads (write / read with DW12 bit 16 set)
+ * name their request with a host chosen 32-bit tag in DW13, unique within the
+ * submission queue while the request is in flight. Configs name their table
+ * in DW14 by the handle it was registered under (ADMIN_EMBED_TABLE_REGISTER)
+ * and give the config encoding (TRANS_CONFIG_FORMAT_*) in DW15. The LBA of
+ * these commands is unused.
+ *
+ * A config with IO_TRANS_CHAIN_MORE set in DW15 is followed by further
+ * configs (segments) under the same tag, the last one has it clear. Reads of
+ * the tag return the result sectors of all segments back to back, in order.
+ */
+#define IO_TRANS_TAG_DWORD									13
+#define IO_TRANS_TABLE_DWORD								14
+#define IO_TRANS_FORMAT_DWORD								15
+#define IO_TRANS_FORMAT_MASK								0xff
+#define IO_TRANS_CHAIN_MORE									(1 << 8)
+#define IO_TRANS_FUSED_CONFIG_DWORD							13 // config sectors - 1, IO_NVM_EMBED_TRANSLATE only
+
+/*
+ * A result read with IO_TRANS_READ_EXACT set in DW15 returns all results of
+ * a single segment request at their exact length (results * embedding length
+ * fp32 values) rather than NLB + 1 padded sectors, NLB is ignored.
+ */
+#define IO_TRANS_READ_FLAGS_DWORD							15
+#define IO_TRANS_READ_EXACT									(1 << 0)
 
 
 /*Status Code Type */
@@ -104,6 +134,7 @@
 #define COMMAND_ABORTED_DUE_TO_FAILED_FUSED_COMMAND			0x9
 #define COMMAND_ABORTED_DUE_TO_MISSING_FUSED_COMMAND		0xA
 #define INVALID_NAMESPACE_OR_FORMAT							0xB
+#define NAMESPACE_NOT_READY									0x82
 
 
 /* Set/Get Features - Features Identifiers */
@@ -343,6 +374,39 @@ typedef struct _ADMIN_IDENTIFY_COMMAND_DW10
 	};
 } ADMIN_IDENTIFY_COMMAND_DW10;
 
+/*
+ * Embedding Table Register Command: DW10 handle, DW11 base LBA, DW12 rows,
+ * DW13 / DW14 row format and policies. DW15 bit 0 unregisters the handle.
+ * DW15 bit 1 instead sets the handle's embedding cache share: DW11 quota in
+ * KB (0 for none), DW12 reservation in KB.
+ */
+typedef struct _ADMIN_EMBED_TABLE_REGISTER_DW13
+{
+	union {
+		unsigned int dword;
+		struct {
+			unsigned short embeddingLength;
+			unsigned char attributeSize;
+			unsigned char layout;
+		};
+	};
+} ADMIN_EMBED_TABLE_REGISTER_DW13;
+
+typedef struct _ADMIN_EMBED_TABLE_REGISTER_DW14
+{
+	union {
+		unsigned int dword;
+		struct {
+			unsigned int cachePolicy	:4;
+			unsigned int idTransform	:4;
+			unsigned int reserved0		:24;
+		};
+	};
+} ADMIN_EMBED_TABLE_REGISTER_DW14;
+
+#define ADMIN_EMBED_TABLE_UNREGISTER						0x1
+#define ADMIN_EMBED_TABLE_CACHE_QUOTA						0x2
+
 /* Get Log Page Command */
 typedef struct _ADMIN_GET_LOG_PAGE_DW10
 {
@@ -55,6 +55,9 @@
 #include "nvme_identify.h"
 #include "nvme_admin_cmd.h"
 
+#include "../trans_registry.h"
+#include "../trans_cache.h"
+
 extern NVME_CONTEXT g_nvmeTask;
 
 unsigned int set_num_of_queue(unsigned int dword11)
@@ -394,6 +397,44 @@ void handle_get_log_page(NVME_ADMIN_COMMAND *nvmeAdminCmd, NVME_COMPLETION *nvme
 	nvmeCPL->specific = 0x9;//invalid log page
 }
 
+void handle_embed_table_register(NVME_ADMIN_COMMAND *nvmeAdminCmd, NVME_COMPLETION *nvmeCPL)
+{
+	ADMIN_EMBED_TABLE_REGISTER_DW13 formatInfo;
+	ADMIN_EMBED_TABLE_REGISTER_DW14 policyInfo;
+	unsigned int registered = 1;
+
+	formatInfo.dword = nvmeAdminCmd->dword13;
+	policyInfo.dword = nvmeAdminCmd->dword14;
+
+	if(nvmeAdminCmd->dword15 & ADMIN_EMBED_TABLE_UNREGISTER)
+	{
+		TransUnregisterTable(nvmeAdminCmd->dword10);
+	}
+	else if(nvmeAdminCmd->dword15 & ADMIN_EMBED_TABLE_CACHE_QUOTA)
+	{
+		registered = TransCacheSetQuota(nvmeAdminCmd->dword10, nvmeAdminCmd->dword11, nvmeAdminCmd->dword12);
+		xil_printf("Embedding table %d: cache quota %d KB, reserved %d KB\r\n", nvmeAdminCmd->dword10,
+				nvmeAdminCmd->dword11, nvmeAdminCmd->dword12);
+	}
+	else
+	{
+		registered = TransRegisterTable(nvmeAdminCmd->dword10, nvmeAdminCmd->dword11, nvmeAdminCmd->dword12,
+				formatInfo.attributeSize, formatInfo.embeddingLength, formatInfo.layout,
+				policyInfo.cachePolicy, policyInfo.idTransform);
+		xil_printf("Embedding table %d: LBA %X, %d rows, length %d, %dB attributes\r\n", nvmeAdminCmd->dword10,
+				nvmeAdminCmd->dword11, nvmeAdminCmd->dword12, formatInfo.embeddingLength, formatInfo.attributeSize);
+	}
+
+	nvmeCPL->dword[0] = 0;
+	nvmeCPL->specific = 0x0;
+	if(!registered)
+	{
+		nvmeCPL->statusField.SCT = GENERIC_COMMAND_STATUS;
+		nvmeCPL->statusField.SC = INVALID_FIELD_IN_COMMAND;
+		nvmeCPL->statusField.DNR = 1;
+	}
+}
+
 void handle_nvme_admin_cmd(NVME_COMMAND *nvmeCmd)
 {
 	NVME_ADMIN_COMMAND *nvmeAdminCmd;
@@ -458,6 +499,11 @@ void handle_nvme_admin_cmd(NVME_COMMAND *nvmeCmd)
 			handle_get_log_page(nvmeAdminCmd, &nvmeCPL);
 			break;
 		}
+		case ADMIN_EMBED_TABLE_REGISTER:
+		{
+			handle_embed_table_register(nvmeAdminCmd, &nvmeCPL);
+			break;
+		}
 
 		default:
 		{
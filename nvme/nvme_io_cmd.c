@@ -51,6 +51,7 @@
 
 
 #include "xil_printf.h"
+#include "xil_cache.h"
 #include "debug.h"
 #include "io_access.h"
 
@@ -65,7 +66,181 @@
 
 unsigned int requests;
 
-void handle_nvme_io_trans(unsigned int cmdSlotTag, NVME_IO_COMMAND *nvmeIOCmd)
+// Malformed translation commands fail instead of halting the device
+static void fail_trans_cmd(unsigned int cmdSlotTag, unsigned int statusCode)
+{
+	NVME_COMPLETION nvmeCPL;
+
+	nvmeCPL.dword[0] = 0;
+	nvmeCPL.statusField.SCT = GENERIC_COMMAND_STATUS;
+	nvmeCPL.statusField.SC = statusCode;
+	nvmeCPL.statusField.DNR = 1;
+	nvmeCPL.specific = 0x0;
+	set_auto_nvme_cpl(cmdSlotTag, nvmeCPL.specific, nvmeCPL.statusFieldWord);
+}
+
+/*
+ * Start the transfer of a config (or preload list, see TRANS_ADMIT_*) of
+ * cmd->sectors sectors into a fresh trans buffer entry, appended to the
+ * request's chain if it has one. Returns 0 if there is no entry or arena room.
+ */
+static unsigned int start_trans_config(const struct transAdmitEntry* cmd)
+{
+	const struct transTableInfo* table = TransLookupTable(cmd->tableHandle);
+	unsigned int preload = (cmd->type == TRANS_ADMIT_PRELOAD);
+
+	// Unregistered while the config waited for admission
+	if (!preload && !table)
+	{
+		fail_trans_cmd(cmd->cmdSlotTag, INVALID_FIELD_IN_COMMAND);
+		return 1;
+	}
+
+	unsigned int entryIdx = AllocateTransBufEntry(preload ? 0 : table->slba, cmd->requestId, cmd->sqId,
+			cmd->sectors * SECTOR_SIZE_FTL);
+	if (entryIdx == 0xffff)
+		return 0;
+	transMap->bufEntry[entryIdx].preload = preload;
+	transMap->bufEntry[entryIdx].configFormat =
+			(cmd->type == TRANS_ADMIT_CONFIG_CSR) ? TRANS_CONFIG_FORMAT_CSR : TRANS_CONFIG_FORMAT_PAIRS;
+	transMap->bufEntry[entryIdx].tableHandle = cmd->tableHandle;
+	transMap->bufEntry[entryIdx].fusedSectors = cmd->resultSectors;
+	if (!preload)
+		transMap->bufEntry[entryIdx].table = *table;
+	transMap->bufEntry[transMap->bufEntry[entryIdx].chainHead].chainOpen = cmd->chain;
+
+	unsigned int devAddr = transMap->bufEntry[entryIdx].configAddr;
+	unsigned int dmaIndex = 0;
+	unsigned int sectorOffset = 0;
+
+	// Drop lines (possibly dirty) left by the arena's previous owner before the DMA writes DRAM
+	Xil_DCacheInvalidateRange(devAddr, cmd->sectors * SECTOR_SIZE_FTL);
+	while(sectorOffset < cmd->sectors)
+	{
+		set_auto_rx_dma(cmd->cmdSlotTag, dmaIndex, devAddr);
+		sectorOffset++;
+		if (++dmaIndex >= 256) dmaIndex = 0;
+		devAddr += SECTOR_SIZE_FTL;
+	}
+
+	transMap->bufEntry[entryIdx].rxDmaExe = 1;
+	transMap->bufEntry[entryIdx].rxDmaTail = g_hostDmaStatus.fifoTail.autoDmaRx;
+	transMap->bufEntry[entryIdx].rxDmaOverFlowCnt = g_hostDmaAssistStatus.autoDmaRxOverFlowCnt;
+
+	// Time spent waiting for admission counts as config write latency
+	transMap->bufEntry[entryIdx].configWriteRequested = cmd->requested;
+
+	PushToTransReqQueue(entryIdx);
+
+	// Fused command: the results go back into the same buffer, after the config
+	if (cmd->resultSectors)
+		PushToTransReadReqQueue(entryIdx, cmd->cmdSlotTag, cmd->resultSectors, cmd->sectors, cmd->requested);
+
+	reservedReq = 1;
+	return 1;
+}
+
+static void reject_trans_cmd(unsigned int cmdSlotTag)
+{
+	NVME_COMPLETION nvmeCPL;
+	unsigned int delay = TRANS_ADMIT_RETRY_DELAY_US;
+
+	// About the time the waiting commands need to drain
+	if (transStats->requests > 0)
+		delay = (unsigned int)(transStats->requestLatency / transStats->requests *
+				transAdmitQ->count / TRANS_BUF_ENTRY_NUM);
+
+	nvmeCPL.dword[0] = 0;
+	nvmeCPL.statusField.SCT = GENERIC_COMMAND_STATUS;
+	nvmeCPL.statusField.SC = NAMESPACE_NOT_READY;
+	nvmeCPL.specific = delay;
+	set_auto_nvme_cpl(cmdSlotTag, nvmeCPL.specific, nvmeCPL.statusFieldWord);
+
+	transStats->admission_rejects++;
+}
+
+static void queue_trans_cmd(const struct transAdmitEntry* cmd)
+{
+	if (cmd->type != TRANS_ADMIT_READ && TRANS_ADMIT_RETRY_DEPTH &&
+			transAdmitQ->count >= TRANS_ADMIT_RETRY_DEPTH)
+	{
+		reject_trans_cmd(cmd->cmdSlotTag);
+		return;
+	}
+
+	ASSERT(transAdmitQ->count < TRANS_ADMIT_QUEUE_DEPTH);
+	transAdmitQ->entry[(transAdmitQ->head + transAdmitQ->count) % TRANS_ADMIT_QUEUE_DEPTH] = *cmd;
+	transAdmitQ->count++;
+
+	if (cmd->type != TRANS_ADMIT_READ)
+		transStats->admission_waits++;
+}
+
+// Newest config (segment) of (sqId, requestID) still waiting for admission, 0 if none
+static struct transAdmitEntry* trans_config_waiting(unsigned int requestID, unsigned int sqId)
+{
+	struct transAdmitEntry* last = 0;
+	unsigned int i;
+
+	for (i = 0; i < transAdmitQ->count; i++)
+	{
+		struct transAdmitEntry* cmd = &transAdmitQ->entry[(transAdmitQ->head + i) % TRANS_ADMIT_QUEUE_DEPTH];
+		if ((cmd->type == TRANS_ADMIT_CONFIG || cmd->type == TRANS_ADMIT_CONFIG_CSR) &&
+				cmd->requestId == requestID && cmd->sqId == sqId)
+			last = cmd;
+	}
+
+	return last;
+}
+
+// Queue a result read on its request, entryIdx is the request's anchor or -1
+static void push_trans_read(const struct transAdmitEntry* cmd, int entryIdx)
+{
+	// Exact length reads take all results of a request with a single segment
+	if (entryIdx < 0 || transMap->bufEntry[entryIdx].exactRead ||
+			(cmd->exact && (transMap->bufEntry[entryIdx].chainOpen ||
+			transMap->bufEntry[entryIdx].chainNext != TRANS_CHAIN_NONE || transMap->bufEntry[entryIdx].nlbRequested)))
+	{
+		fail_trans_cmd(cmd->cmdSlotTag, INVALID_FIELD_IN_COMMAND);
+		return;
+	}
+
+	if (cmd->exact)
+		PushToTransExactReadReqQueue(entryIdx, cmd->cmdSlotTag, cmd->prp, cmd->requested);
+	else
+		PushToTransReadReqQueue(entryIdx, cmd->cmdSlotTag, cmd->sectors, 0, cmd->requested);
+
+	reservedReq = 1;
+}
+
+/*
+ * Start waiting translation commands in order, called from the main loop
+ * after an entry has been deallocated.
+ */
+void admit_trans_cmds()
+{
+	transAdmitQ->entryFreed = 0;
+
+	while (transAdmitQ->count)
+	{
+		struct transAdmitEntry* cmd = &transAdmitQ->entry[transAdmitQ->head];
+
+		if (cmd->type == TRANS_ADMIT_READ)
+		{
+			// Its config was started (or failed) ahead of it
+			push_trans_read(cmd, findTransBufEntry(cmd->requestId, cmd->sqId));
+		}
+		else if (!start_trans_config(cmd))
+		{
+			break;
+		}
+
+		transAdmitQ->head = (transAdmitQ->head + 1) % TRANS_ADMIT_QUEUE_DEPTH;
+		transAdmitQ->count--;
+	}
+}
+
+void handle_nvme_io_trans(unsigned int cmdSlotTag, unsigned int sqId, NVME_IO_COMMAND *nvmeIOCmd)
 {
   // ----------------------------------------------------------------------
   // Parse NVMe Command
@@ -96,41 +271,140 @@ void handle_nvme_io_trans(unsigned int cmdSlotTag, NVME_IO_COMMAND *nvmeIOCmd)
 	hostCmd.reqSect = nlb + 1;
 	hostCmd.cmdSlotTag = cmdSlotTag;
 
+	struct transAdmitEntry cmd;
+	unsigned int format = nvmeIOCmd->dword[IO_TRANS_FORMAT_DWORD] & IO_TRANS_FORMAT_MASK;
+
+	cmd.type = (format == TRANS_CONFIG_FORMAT_CSR) ? TRANS_ADMIT_CONFIG_CSR : TRANS_ADMIT_CONFIG;
+	cmd.cmdSlotTag = cmdSlotTag;
+	cmd.sqId = sqId;
+	cmd.tableHandle = nvmeIOCmd->dword[IO_TRANS_TABLE_DWORD];
+	cmd.requestId = nvmeIOCmd->dword[IO_TRANS_TAG_DWORD];
+	cmd.sectors = hostCmd.reqSect;
+	cmd.resultSectors = 0;
+	cmd.chain = (nvmeIOCmd->dword[IO_TRANS_FORMAT_DWORD] & IO_TRANS_CHAIN_MORE) != 0;
+	cmd.exact = 0;
+
+	if (hostCmd.reqSect > TRANS_CONFIG_SIZE / SECTOR_SIZE_FTL)
+	{
+		fail_trans_cmd(cmdSlotTag, INVALID_FIELD_IN_COMMAND);
+		return;
+	}
+
 	/*
-	 * Need to separate the requested sector into both a TableID and a RequestID.
-	 *
-	 * Let's assume tables are larger than 1K sectors (4MB), and 4M aligned. This way
-	 * we can assume (reqSect / 1K)*1K = TableSeq and reqSect % 1K = RequestID.
+	 * The tag names the request until its results are read. It only takes
+	 * another config if the newest segment so far announced one.
 	 */
-	unsigned int tableSLBA = (hostCmd.curSect / 1000) * 1000;
-	unsigned int requestID = hostCmd.curSect % 1000;
+	struct transAdmitEntry* waiting = transAdmitQ->count ? trans_config_waiting(cmd.requestId, sqId) : 0;
+	int anchor = findTransBufEntry(cmd.requestId, sqId);
+	if (!TransRequestTagged(cmd.requestId) ||
+			(waiting ? !waiting->chain : (anchor >= 0 && !transMap->bufEntry[anchor].chainOpen)))
+	{
+		fail_trans_cmd(cmdSlotTag, COMMAND_ID_CONFLICT);
+		return;
+	}
+	if (!TransLookupTable(cmd.tableHandle) || format >= TRANS_CONFIG_FORMAT_NUM)
+	{
+		fail_trans_cmd(cmdSlotTag, INVALID_FIELD_IN_COMMAND);
+		return;
+	}
 
-	unsigned int entryIdx = AllocateTransBufEntry(tableSLBA, requestID);
-	ASSERT(entryIdx != 0xffff);
+	cmd.requested = 0;
+	XTime_GetTime(&cmd.requested);
 
-	unsigned int devAddr = TRANS_CONFIG_ADDR + entryIdx * TRANS_CONFIG_SIZE;
-	unsigned int dmaIndex = 0;
-	unsigned int sectorOffset = 0;
-	while(sectorOffset < hostCmd.reqSect)
+	// Commands already waiting go first
+	if (transAdmitQ->count == 0 && start_trans_config(&cmd))
+		return;
+
+	queue_trans_cmd(&cmd);
+}
+
+/*
+ * Vendor fused translation (IO_NVM_EMBED_TRANSLATE): the first DW13 + 1
+ * sectors of the data buffer carry the config, the pooled results are
+ * returned into the sectors after it, which must be exactly the request's
+ * result sectors. The command completes with its last result sector, so no
+ * tag or separate read is needed. DW14 and DW15 are as for a translation
+ * config, without chaining.
+ */
+void handle_nvme_io_fused_trans(unsigned int cmdSlotTag, unsigned int sqId, NVME_IO_COMMAND *nvmeIOCmd)
+{
+	IO_READ_COMMAND_DW12 info12;
+	struct transAdmitEntry cmd;
+	unsigned int format = nvmeIOCmd->dword[IO_TRANS_FORMAT_DWORD] & IO_TRANS_FORMAT_MASK;
+	unsigned int sectors;
+
+	info12.dword = nvmeIOCmd->dword[12];
+	sectors = info12.NLB + 1;
+
+	ASSERT((nvmeIOCmd->PRP1[0] & 0x7) == 0 && (nvmeIOCmd->PRP2[0] & 0x7) == 0);
+
+	cmd.type = (format == TRANS_CONFIG_FORMAT_CSR) ? TRANS_ADMIT_CONFIG_CSR : TRANS_ADMIT_CONFIG;
+	cmd.cmdSlotTag = cmdSlotTag;
+	cmd.sqId = sqId;
+	cmd.tableHandle = nvmeIOCmd->dword[IO_TRANS_TABLE_DWORD];
+	cmd.requestId = TRANS_FUSED_REQUEST_ID;
+	cmd.sectors = nvmeIOCmd->dword[IO_TRANS_FUSED_CONFIG_DWORD] + 1;
+	cmd.chain = 0;
+	cmd.exact = 0;
+
+	// Config and results share the command's 256 auto DMA slots
+	if (!TransLookupTable(cmd.tableHandle) || format >= TRANS_CONFIG_FORMAT_NUM ||
+			sectors > 256 || cmd.sectors >= sectors)
 	{
-		set_auto_rx_dma(cmdSlotTag, dmaIndex, devAddr);
-		sectorOffset++;
-		if (++dmaIndex >= 256) dmaIndex = 0;
-		devAddr += SECTOR_SIZE_FTL;
+		fail_trans_cmd(cmdSlotTag, INVALID_FIELD_IN_COMMAND);
+		return;
 	}
+	cmd.resultSectors = sectors - cmd.sectors;
 
-	transMap->bufEntry[entryIdx].rxDmaExe = 1;
-	transMap->bufEntry[entryIdx].rxDmaTail = g_hostDmaStatus.fifoTail.autoDmaRx;
-	transMap->bufEntry[entryIdx].rxDmaOverFlowCnt = g_hostDmaAssistStatus.autoDmaRxOverFlowCnt;
+	cmd.requested = 0;
+	XTime_GetTime(&cmd.requested);
 
-	XTime_GetTime(&transMap->bufEntry[entryIdx].configWriteRequested);
+	if (transAdmitQ->count == 0 && start_trans_config(&cmd))
+		return;
 
-	PushToTransReqQueue(entryIdx);
+	queue_trans_cmd(&cmd);
+}
 
-	reservedReq = 1;
+/*
+ * Vendor preload: the data is a struct transPreloadConfig, moved like a
+ * translation config. The command completes once the list is transferred,
+ * the rows are pinned in the background by the translation queue.
+ */
+void handle_nvme_io_preload(unsigned int cmdSlotTag, NVME_IO_COMMAND *nvmeIOCmd)
+{
+	IO_READ_COMMAND_DW12 writeInfo12;
+	unsigned int nlb;
+
+	writeInfo12.dword = nvmeIOCmd->dword[12];
+	nlb = writeInfo12.NLB;
+
+	ASSERT((nvmeIOCmd->PRP1[0] & 0x7) == 0 && (nvmeIOCmd->PRP2[0] & 0x7) == 0);
+	if (nlb >= TRANS_CONFIG_SIZE / SECTOR_SIZE_FTL)
+	{
+		fail_trans_cmd(cmdSlotTag, INVALID_FIELD_IN_COMMAND);
+		return;
+	}
+
+	struct transAdmitEntry cmd;
+	cmd.type = TRANS_ADMIT_PRELOAD;
+	cmd.cmdSlotTag = cmdSlotTag;
+	cmd.sqId = 0;
+	cmd.tableHandle = 0;
+	cmd.requestId = TRANS_PRELOAD_REQUEST_ID;
+	cmd.sectors = nlb + 1;
+	cmd.resultSectors = 0;
+	cmd.chain = 0;
+	cmd.exact = 0;
+	cmd.requested = 0;
+	XTime_GetTime(&cmd.requested);
+
+	if (transAdmitQ->count == 0 && start_trans_config(&cmd))
+		return;
+
+	queue_trans_cmd(&cmd);
 }
 
-void handle_nvme_io_read_trans(unsigned int cmdSlotTag, NVME_IO_COMMAND *nvmeIOCmd)
+void handle_nvme_io_read_trans(unsigned int cmdSlotTag, unsigned int sqId, NVME_IO_COMMAND *nvmeIOCmd)
 {
 	IO_READ_COMMAND_DW12 readInfo12;
 	//IO_READ_COMMAND_DW13 readInfo13;
@@ -156,37 +430,47 @@ void handle_nvme_io_read_trans(unsigned int cmdSlotTag, NVME_IO_COMMAND *nvmeIOC
 	hostCmd.reqSect = nlb + 1;
 	hostCmd.cmdSlotTag = cmdSlotTag;
 
-	/*
-	 * Need to separate the requested sector into both a TableID and a RequestID.
-	 *
-	 * Let's assume tables are larger than 1K sectors (4MB), and 4M aligned. This way
-	 * we can assume (reqSect / 1K)*1K = TableSeq and reqSect % 1K = RequestID.
-	 */
-	//unsigned int tableSLBA = (hostCmd.curSect / 1000) * 1000;
-	unsigned int requestID = hostCmd.curSect % 1000;
+	unsigned int requestID = nvmeIOCmd->dword[IO_TRANS_TAG_DWORD];
 
 	// ----------------------------------------------------------------------
 	// Return result pages.
 	// ----------------------------------------------------------------------
-	int entryIdx = findTransBufEntry(requestID);
-	ASSERT(entryIdx >= 0);
-
+	// Stamped on the returned sectors, the entry may not have its sector bookkeeping yet
 	XTime xtime = 0;
 	XTime_GetTime(&xtime);
-	int sector;
-	for (sector = transMap->bufEntry[entryIdx].nlbRequested;
-		 sector < transMap->bufEntry[entryIdx].nlbRequested + hostCmd.reqSect;
-		 sector++)
+
+	struct transAdmitEntry cmd;
+	cmd.type = TRANS_ADMIT_READ;
+	cmd.cmdSlotTag = cmdSlotTag;
+	cmd.sqId = sqId;
+	cmd.tableHandle = 0;
+	cmd.requestId = requestID;
+	cmd.sectors = hostCmd.reqSect;
+	cmd.resultSectors = 0;
+	cmd.chain = 0;
+	cmd.exact = (nvmeIOCmd->dword[IO_TRANS_READ_FLAGS_DWORD] & IO_TRANS_READ_EXACT) != 0;
+	cmd.prp[0] = nvmeIOCmd->PRP1[0];
+	cmd.prp[1] = nvmeIOCmd->PRP1[1];
+	cmd.prp[2] = nvmeIOCmd->PRP2[0];
+	cmd.prp[3] = nvmeIOCmd->PRP2[1];
+	cmd.requested = xtime;
+
+	/*
+	 * The config is still waiting for admission, so does its read. Reads of a
+	 * chain whose first segment is in go ahead of later segments, their
+	 * sectors stream out as each segment completes.
+	 */
+	int entryIdx = findTransBufEntry(requestID, sqId);
+	if (entryIdx < 0 && transAdmitQ->count && trans_config_waiting(requestID, sqId))
 	{
-		transMap->bufEntry[entryIdx].sectorRequested[sector] = xtime;
+		queue_trans_cmd(&cmd);
+		return;
 	}
 
-	PushToTransReadReqQueue(entryIdx, hostCmd.cmdSlotTag, hostCmd.reqSect);
-
-	reservedReq = 1;
+	push_trans_read(&cmd, entryIdx);
 }
 
-void handle_nvme_io_read(unsigned int cmdSlotTag, NVME_IO_COMMAND *nvmeIOCmd)
+void handle_nvme_io_read(unsigned int cmdSlotTag, unsigned int sqId, NVME_IO_COMMAND *nvmeIOCmd)
 {
 	IO_READ_COMMAND_DW12 readInfo12;
 	//IO_READ_COMMAND_DW13 readInfo13;
@@ -201,7 +485,7 @@ void handle_nvme_io_read(unsigned int cmdSlotTag, NVME_IO_COMMAND *nvmeIOCmd)
 
 	if (readInfo12.reserved0 == 1)
 	{
-		handle_nvme_io_read_trans(cmdSlotTag, nvmeIOCmd);
+		handle_nvme_io_read_trans(cmdSlotTag, sqId, nvmeIOCmd);
 		return;
 	}
 
@@ -221,7 +505,7 @@ void handle_nvme_io_read(unsigned int cmdSlotTag, NVME_IO_COMMAND *nvmeIOCmd)
 	LRUBufRead(&hostCmd);
 }
 
-void handle_nvme_io_write(unsigned int cmdSlotTag, NVME_IO_COMMAND *nvmeIOCmd)
+void handle_nvme_io_write(unsigned int cmdSlotTag, unsigned int sqId, NVME_IO_COMMAND *nvmeIOCmd)
 {
 	IO_READ_COMMAND_DW12 writeInfo12;
 	//IO_READ_COMMAND_DW13 writeInfo13;
@@ -235,7 +519,7 @@ void handle_nvme_io_write(unsigned int cmdSlotTag, NVME_IO_COMMAND *nvmeIOCmd)
 
 	if (writeInfo12.reserved0 == 1)
 	{
-		handle_nvme_io_trans(cmdSlotTag, nvmeIOCmd);
+		handle_nvme_io_trans(cmdSlotTag, sqId, nvmeIOCmd);
 		return;
 	}
 
@@ -255,6 +539,7 @@ void handle_nvme_io_write(unsigned int cmdSlotTag, NVME_IO_COMMAND *nvmeIOCmd)
 	hostCmd.reqSect = nlb + 1;
 	hostCmd.cmdSlotTag = cmdSlotTag;
 
+	TransTablesWritten(hostCmd.curSect, hostCmd.reqSect);
 	LRUBufWrite(&hostCmd);
 }
 
@@ -310,6 +595,22 @@ void handle_nvme_io_cmd(NVME_COMMAND *nvmeCmd)
 						(long int)((transStats->cache_hits /
 						 (transStats->cache_hits + transStats->cache_misses))*
 						100));
+				xil_printf("Embedding Cache Hits/Misses/Evictions: %ld/%ld/%ld (%d-way)\r\n",
+						(long int)transStats->cache_hits, (long int)transStats->cache_misses,
+						(long int)transStats->cache_evictions, TRANS_EMBED_CACHE_WAYS);
+				xil_printf("Embedding Cache Admission Rejects/Bypasses/Quota Rejects: %ld/%ld/%ld\r\n",
+						(long int)transStats->cache_rejections, (long int)transStats->cache_bypasses,
+						(long int)transStats->cache_quota_rejects);
+				xil_printf("Embedding Cache OCM Hits/Promotions: %ld/%ld\r\n",
+						(long int)transStats->cache_l1_hits, (long int)transStats->cache_l1_promotions);
+				xil_printf("Translation Page Reads Merged In Flight: %ld\r\n",
+						(long int)transStats->merged_page_reads);
+				xil_printf("Translation Commands Queued/Rejected for Admission: %ld/%ld\r\n",
+						(long int)transStats->admission_waits, (long int)transStats->admission_rejects);
+				xil_printf("Translation Requests/Preloads Failed on Their Config: %ld/%ld, Preload Rows Skipped: %ld\r\n",
+						(long int)transStats->failed_requests, (long int)transStats->failed_preloads,
+						(long int)transStats->skipped_preload_rows);
+				TransCachePrintStats();
 			}
 			transStats->requestLatency = 0;
 			transStats->configWriteLatency = 0;
@@ -323,18 +624,30 @@ void handle_nvme_io_cmd(NVME_COMMAND *nvmeCmd)
 			transStats->totalReadLatency = 0;
 			transStats->cache_hits = 0;
 			transStats->cache_misses = 0;
+			transStats->cache_evictions = 0;
+			transStats->cache_rejections = 0;
+			transStats->cache_bypasses = 0;
+			transStats->cache_l1_hits = 0;
+			transStats->cache_l1_promotions = 0;
+			transStats->cache_quota_rejects = 0;
+			transStats->merged_page_reads = 0;
+			transStats->admission_waits = 0;
+			transStats->admission_rejects = 0;
+			transStats->failed_requests = 0;
+			transStats->failed_preloads = 0;
+			transStats->skipped_preload_rows = 0;
 			break;
 		}
 		case IO_NVM_WRITE:
 		{
 			//xil_printf("IO Write Command\r\n");
-			handle_nvme_io_write(nvmeCmd->cmdSlotTag, nvmeIOCmd);
+			handle_nvme_io_write(nvmeCmd->cmdSlotTag, nvmeCmd->qID, nvmeIOCmd);
 			break;
 		}
 		case IO_NVM_READ:
 		{
 			//xil_printf("IO Read Command\r\n");
-			handle_nvme_io_read(nvmeCmd->cmdSlotTag, nvmeIOCmd);
+			handle_nvme_io_read(nvmeCmd->cmdSlotTag, nvmeCmd->qID, nvmeIOCmd);
 			break;
 		}
 		case IO_NVM_TRANS:
@@ -342,7 +655,7 @@ void handle_nvme_io_cmd(NVME_COMMAND *nvmeCmd)
 			xil_printf("Command Deprecated: %X\r\n", opc);
 			ASSERT(0);
 			//xil_printf("IO Translate Command\r\n");
-			handle_nvme_io_trans(nvmeCmd->cmdSlotTag, nvmeIOCmd);
+			handle_nvme_io_trans(nvmeCmd->cmdSlotTag, nvmeCmd->qID, nvmeIOCmd);
 			break;
 		}
 		case IO_NVM_READ_TRANS:
@@ -350,7 +663,19 @@ void handle_nvme_io_cmd(NVME_COMMAND *nvmeCmd)
 			xil_printf("Command Deprecated: %X\r\n", opc);
 			ASSERT(0);
 			//xil_printf("IO Translate Read Command\r\n");
-			handle_nvme_io_read_trans(nvmeCmd->cmdSlotTag, nvmeIOCmd);
+			handle_nvme_io_read_trans(nvmeCmd->cmdSlotTag, nvmeCmd->qID, nvmeIOCmd);
+			break;
+		}
+		case IO_NVM_EMBED_PRELOAD:
+		{
+			//xil_printf("IO Embedding Preload Command\r\n");
+			handle_nvme_io_preload(nvmeCmd->cmdSlotTag, nvmeIOCmd);
+			break;
+		}
+		case IO_NVM_EMBED_TRANSLATE:
+		{
+			//xil_printf("IO Embedding Translate Command\r\n");
+			handle_nvme_io_fused_trans(nvmeCmd->cmdSlotTag, nvmeCmd->qID, nvmeIOCmd);
 			break;
 		}
 		default:
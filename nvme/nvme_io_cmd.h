@@ -48,5 +48,6 @@
 #define __NVME_IO_CMD_H_
 
 void handle_nvme_io_cmd(NVME_COMMAND *nvmeCmd);
+void admit_trans_cmds();
 
 #endif	//__NVME_IO_CMD_H_
@@ -91,7 +91,16 @@ void nvme_main()
 	xil_printf("!!! Wait until FTL reset complete !!! \r\n");
 
 	LRUBufInit();
+	TransRegistryInit();
 	TransBufInit();
+	TransCacheInit();
+#ifdef TRANS_CACHE_SELF_TEST
+	TransCacheSelfTest();
+#endif
+#ifdef TRANS_KERNEL_BENCHMARK
+	// Scratchpads are idle until the host is up
+	TransKernelBenchmark((void*)TRANS_ARENA_ADDR, (void*)(TRANS_ARENA_ADDR + TRANS_SCRATCHPAD_SIZE), TRANS_SCRATCHPAD_SIZE);
+#endif
 	InitChCtlReg();
 	InitDieReqQueue();
 	InitDieStatusTable();
@@ -99,6 +108,7 @@ void nvme_main()
 	EmptyLowLevelQ(SUB_REQ_QUEUE);
 
 	InitFtlMapTable();
+	TransWarmInit();
 
 	xil_printf("\r\nFTL reset complete!!! \r\n");
 	xil_printf("Turn on the host PC \r\n");
@@ -156,6 +166,7 @@ void nvme_main()
 
 				set_nvme_admin_queue(0, 0, 0);
 				g_nvmeTask.cacheEn = 0;
+				TransWarmCheckpoint();
 				set_nvme_csts_shst(2);
 				g_nvmeTask.status = NVME_TASK_WAIT_RESET;
 				xil_printf("\r\nNVMe shutdown!!!\r\n");
@@ -188,9 +199,17 @@ void nvme_main()
 			set_nvme_csts_rdy(0);
 			g_nvmeTask.status = NVME_TASK_IDLE;
 			TransBufInit();
+			TransCacheInvalidate();
 			xil_printf("\r\nNVMe reset!!!\r\n");
 		}
 
+		ReapTransDrains();
+
+		if(transAdmitQ->count && transAdmitQ->entryFreed)
+			admit_trans_cmds();
+
+		TransWarmStep();
+
 		if(exeLlr && reservedReq)
 			ExeLowLevelReq(SUB_REQ_QUEUE);
 	}
@@ -126,7 +126,7 @@ void InitBlockMap(unsigned int badBlockTableAddr)
 		for(j=0 ; j<DIE_NUM ; j++)
 		{
 			phyBlock = (i / BLOCK_NUM_PER_LUN) * MAX_BLOCK_NUM_PER_LUN + i % BLOCK_NUM_PER_LUN;
-			if(phyBlock == metadataBlockNo)
+			if((phyBlock == metadataBlockNo) || (phyBlock == TRANS_WARM_BLOCK_NO))
 				blockMap->bmEntry[j][i].free = 0;
 			else
 				blockMap->bmEntry[j][i].free = 1;
@@ -144,7 +144,7 @@ void InitBlockMap(unsigned int badBlockTableAddr)
 		for (j = 0; j < DIE_NUM; ++j)
 		{
 			phyBlock = (i / BLOCK_NUM_PER_LUN) * MAX_BLOCK_NUM_PER_LUN + i % BLOCK_NUM_PER_LUN;
-			if (!blockMap->bmEntry[j][i].bad && (phyBlock != metadataBlockNo))
+			if (!blockMap->bmEntry[j][i].bad && (phyBlock != metadataBlockNo) && (phyBlock != TRANS_WARM_BLOCK_NO))
 				PushToSubReqQueue(j % CHANNEL_NUM, j / CHANNEL_NUM, V2FCommand_BlockErase, i*PAGE_NUM_PER_BLOCK, NONE, NONE);
 		}
 
@@ -344,7 +344,7 @@ void InitDieBlock()
 		for(j=0 ; j<BLOCK_NUM_PER_DIE ; j++)
 		{
 			phyBlock = (j / BLOCK_NUM_PER_LUN) * MAX_BLOCK_NUM_PER_LUN + j % BLOCK_NUM_PER_LUN;
-			if ((!blockMap->bmEntry[i][j].bad) &&  (phyBlock != metadataBlockNo))
+			if ((!blockMap->bmEntry[i][j].bad) &&  (phyBlock != metadataBlockNo) && (phyBlock != TRANS_WARM_BLOCK_NO))
 			{
 				dieBlock->dieEntry[i].currentBlock = j;
 				blockMap->bmEntry[i][j].free = 0;
@@ -356,7 +356,7 @@ void InitDieBlock()
 		for(j=BLOCK_NUM_PER_DIE-1; j>=0 ; j--)
 		{
 			phyBlock = (j / BLOCK_NUM_PER_LUN) * MAX_BLOCK_NUM_PER_LUN + j % BLOCK_NUM_PER_LUN;
-			if ((!blockMap->bmEntry[i][j].bad) && (phyBlock != metadataBlockNo))
+			if ((!blockMap->bmEntry[i][j].bad) && (phyBlock != metadataBlockNo) && (phyBlock != TRANS_WARM_BLOCK_NO))
 			{
 				dieBlock->dieEntry[i].freeBlock = j;
 				blockMap->bmEntry[i][j].free = 0;
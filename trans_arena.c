@@ -0,0 +1,87 @@
+// Harvard University, VLSI-Arch Lab
+// DRAM arena for per-request translation buffers and bookkeeping
+
+#include	"trans_arena.h"
+#include	"memory_map.h"
+#include	"low_level_scheduler.h"
+
+struct transArenaMap* transArena;
+
+void TransArenaInit()
+{
+	unsigned int block;
+
+	transArena = (struct transArenaMap*)TRANS_ARENA_MAP_ADDR;
+	for (block = 0; block < TRANS_ARENA_BLOCK_NUM; block++)
+	{
+		transArena->owner[block] = TRANS_ARENA_FREE;
+		transArena->config[block] = 0;
+	}
+	transArena->freeBlocks = TRANS_ARENA_BLOCK_NUM;
+	transArena->configBlocks = 0;
+}
+
+/*
+ * Returns the DRAM address of bytes owned by owner, block aligned, or 0 if
+ * the arena has no run long enough. config allocations are limited to
+ * TRANS_ARENA_CONFIG_BLOCKS in total.
+ */
+unsigned int TransArenaAlloc(unsigned int owner, unsigned int bytes, unsigned int config)
+{
+	unsigned int blocks = (bytes + TRANS_ARENA_BLOCK_SIZE - 1) / TRANS_ARENA_BLOCK_SIZE;
+	unsigned int block, run = 0;
+
+	if (blocks == 0)
+		blocks = 1;
+	if (blocks > transArena->freeBlocks ||
+			(config && transArena->configBlocks + blocks > TRANS_ARENA_CONFIG_BLOCKS))
+		return 0;
+
+	for (block = 0; block < TRANS_ARENA_BLOCK_NUM; block++)
+	{
+		run = (transArena->owner[block] == TRANS_ARENA_FREE) ? run + 1 : 0;
+		if (run == blocks)
+			break;
+	}
+	if (block == TRANS_ARENA_BLOCK_NUM)
+		return 0;
+
+	for (block = block + 1 - blocks; run; run--, block++)
+	{
+		transArena->owner[block] = owner;
+		transArena->config[block] = config;
+	}
+	transArena->freeBlocks -= blocks;
+	if (config)
+		transArena->configBlocks += blocks;
+
+	return TRANS_ARENA_ADDR + (block - blocks) * TRANS_ARENA_BLOCK_SIZE;
+}
+
+// Hand every allocation of owner over to newOwner, which must own none
+void TransArenaMove(unsigned int owner, unsigned int newOwner)
+{
+	unsigned int block;
+
+	for (block = 0; block < TRANS_ARENA_BLOCK_NUM; block++)
+		if (transArena->owner[block] == owner)
+			transArena->owner[block] = newOwner;
+}
+
+// Release every allocation of owner
+void TransArenaFree(unsigned int owner)
+{
+	unsigned int block;
+
+	for (block = 0; block < TRANS_ARENA_BLOCK_NUM; block++)
+	{
+		if (transArena->owner[block] != owner)
+			continue;
+
+		transArena->owner[block] = TRANS_ARENA_FREE;
+		transArena->freeBlocks++;
+		if (transArena->config[block])
+			transArena->configBlocks--;
+		transArena->config[block] = 0;
+	}
+}
@@ -0,0 +1,37 @@
+// Harvard University, VLSI-Arch Lab
+// DRAM arena for per-request translation buffers and bookkeeping
+
+#ifndef TRANS_ARENA_H_
+#define TRANS_ARENA_H_
+
+/*
+ * Configs, result scratchpads and per-page / per-sector bookkeeping of the
+ * translation requests are carved out of one arena, sized by the request
+ * instead of for the largest one. The arena is cut into blocks, an allocation
+ * is a run of contiguous blocks (first fit) tagged with the owning trans
+ * buffer entry, and all blocks of an entry are freed together.
+ *
+ * Configs may hold at most half of the arena, so configs which have been
+ * received always leave room for their bookkeeping.
+ */
+#define TRANS_ARENA_SIZE (48 * 1024 * 1024)
+#define TRANS_ARENA_BLOCK_SIZE (16 * 1024)
+#define TRANS_ARENA_BLOCK_NUM (TRANS_ARENA_SIZE / TRANS_ARENA_BLOCK_SIZE)
+#define TRANS_ARENA_CONFIG_BLOCKS (TRANS_ARENA_BLOCK_NUM / 2)
+#define TRANS_ARENA_FREE 0xff
+
+struct transArenaMap {
+	unsigned char owner[TRANS_ARENA_BLOCK_NUM];
+	unsigned char config[TRANS_ARENA_BLOCK_NUM]; // block holds a config
+	unsigned int freeBlocks;
+	unsigned int configBlocks;
+};
+
+extern struct transArenaMap* transArena;
+
+void TransArenaInit();
+unsigned int TransArenaAlloc(unsigned int owner, unsigned int bytes, unsigned int config);
+void TransArenaFree(unsigned int owner);
+void TransArenaMove(unsigned int owner, unsigned int newOwner);
+
+#endif /* TRANS_ARENA_H_ */
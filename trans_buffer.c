@@ -9,17 +9,24 @@
 #include	"memory_map.h"
 #include	"nvme/host_lld.h"
 #include	"low_level_scheduler.h"
+#include	"xil_cache.h"
 
 struct transBufArray* transMap;
 struct transBufAvailQueue* transAvailQ;
+struct transAdmitQueue* transAdmitQ;
+struct transTagTable* transTags;
 struct transStatistics* transStats;
+struct transMshrTable* transMshr;
 
-struct transEmbedCache* transCache;
+// Slots whose previous scratchpad is still being sent, see ReapTransDrains
+static unsigned int transDrains;
 
 void TransBufInit()
 {
   transMap = (struct transBufArray*) TRANS_BUF_MAP_ADDR;
   transAvailQ = (struct transBufAvailQueue*) TRANS_AVAIL_Q_ADDR;
+  transAdmitQ = (struct transAdmitQueue*) TRANS_ADMIT_Q_ADDR;
+  transTags = (struct transTagTable*) TRANS_TAG_TABLE_ADDR;
   transStats = (struct transStatistics*) TRANS_STATS_ADDR;
   transStats->requestLatency = 0;
   transStats->configWriteLatency = 0;
@@ -32,8 +39,20 @@ void TransBufInit()
   transStats->sectors = 0;
   transStats->cache_hits = 0;
   transStats->cache_misses = 0;
+  transStats->cache_evictions = 0;
+  transStats->cache_rejections = 0;
+  transStats->cache_bypasses = 0;
+  transStats->cache_l1_hits = 0;
+  transStats->cache_l1_promotions = 0;
+  transStats->cache_quota_rejects = 0;
+  transStats->merged_page_reads = 0;
+  transStats->admission_waits = 0;
+  transStats->admission_rejects = 0;
+  transStats->failed_requests = 0;
+  transStats->failed_preloads = 0;
+  transStats->skipped_preload_rows = 0;
 
-  int i;
+  int i, j;
   for (i = 0; i < TRANS_BUF_ENTRY_NUM; i++)
   {
     transMap->bufEntry[i].rxDmaExe = 0;
@@ -41,70 +60,155 @@ void TransBufInit()
     transMap->bufEntry[i].next = i == TRANS_BUF_ENTRY_NUM-1 ? 0xffff : i+1;
     transMap->bufEntry[i].allocated = 0;
     transMap->bufEntry[i].configured = 0;
+    transMap->bufEntry[i].draining = 0;
+    transMap->bufEntry[i].drainQueued = 0;
   }
+  transDrains = 0;
 
   transAvailQ->head = 0;
   transAvailQ->tail = TRANS_BUF_ENTRY_NUM-1;
 
-  transCache = (struct transEmbedCache*)(TRANS_EMBED_CACHE_ADDR);
-  for (i = 0; i < TRANS_EMBED_CACHE_ENTRY_NUM; i++)
+  transAdmitQ->head = 0;
+  transAdmitQ->count = 0;
+  transAdmitQ->entryFreed = 0;
+
+  for (i = 0; i < TRANS_TAG_HASH_NUM; i++)
+    transTags->bucket[i] = TRANS_TAG_NONE;
+
+  transMshr = (struct transMshrTable*) TRANS_MSHR_ADDR;
+  for (i = 0; i < DIE_NUM; i++)
+    for (j = 0; j < TRANS_MSHR_NUM_PER_DIE; j++)
+      transMshr->mshr[i][j].valid = 0;
+  for (i = 0; i < TRANS_MSHR_WAITER_NUM; i++)
+    transMshr->waiter[i].next = (i == TRANS_MSHR_WAITER_NUM-1) ? TRANS_MSHR_NONE : i+1;
+  transMshr->freeWaiter = 0;
+
+  TransArenaInit();
+}
+
+static inline unsigned int TransHashID(unsigned int id)
+{
+	id ^= id >> 16;
+	id *= 0x85ebca6b;
+	id ^= id >> 13;
+	id *= 0xc2b2ae35;
+	id ^= id >> 16;
+	return id;
+}
+
+static inline unsigned int TransTagBucket(unsigned int requestId, unsigned int sqId)
+{
+  return TransHashID(requestId ^ (sqId << 28)) & (TRANS_TAG_HASH_NUM - 1);
+}
+
+static void AppendTransAvailQ(unsigned int entryIdx)
+{
+  transMap->bufEntry[entryIdx].prev = transAvailQ->tail;
+  transMap->bufEntry[entryIdx].next = 0xffff;
+  if (transAvailQ->tail == 0xffff)
+  {
+    transAvailQ->head = entryIdx;
+  }
+  else
   {
-	  transCache->cacheEntry[i].valid = 0;
+    transMap->bufEntry[transAvailQ->tail].next = entryIdx;
   }
+  transAvailQ->tail = entryIdx;
 }
 
-unsigned int AllocateTransBufEntry(unsigned int slba, unsigned int requestId)
+static void ReleaseTransBufEntry(unsigned int entryIdx)
 {
-  unsigned int entryIdx = 0xffff;
+  transMap->bufEntry[entryIdx].allocated = 0;
+  transMap->bufEntry[entryIdx].configured = 0;
+
+  // Still owns a scratchpad being sent, ReapTransDrains frees the slot with it
+  if (transMap->bufEntry[entryIdx].drainQueued)
+    return;
+  AppendTransAvailQ(entryIdx);
+}
 
-  if (transAvailQ->head != 0xffff)
+/*
+ * Takes a free entry along with arena room for its config of configBytes.
+ * Returns 0xffff if either is exhausted, the caller queues the command.
+ */
+unsigned int AllocateTransBufEntry(unsigned int slba, unsigned int requestId, unsigned int sqId, unsigned int configBytes)
+{
+  unsigned int entryIdx;
+
+  if (transAvailQ->head == 0xffff)
+    return 0xffff;
+
+  entryIdx = transAvailQ->head;
+  if (transAvailQ->head == transAvailQ->tail)
   {
-    entryIdx = transAvailQ->head;
-    if (transAvailQ->head == transAvailQ->tail)
-    {
-      transAvailQ->head = 0xffff;
-      transAvailQ->tail = 0xffff;
-    }
-    else
-    {
-      transAvailQ->head = transMap->bufEntry[transAvailQ->head].next;
-      transMap->bufEntry[transAvailQ->head].prev = 0xffff;
-    }
+    transAvailQ->head = 0xffff;
+    transAvailQ->tail = 0xffff;
   }
   else
   {
-	  ASSERT(0); // No room for the request! Bahh!
+    transAvailQ->head = transMap->bufEntry[transAvailQ->head].next;
+    transMap->bufEntry[transAvailQ->head].prev = 0xffff;
+  }
+
+  transMap->bufEntry[entryIdx].configAddr = TransArenaAlloc(entryIdx, configBytes, 1);
+  transMap->bufEntry[entryIdx].configBytes = configBytes;
+  if (!transMap->bufEntry[entryIdx].configAddr)
+  {
+    // Back to the tail, the order of free entries doesn't matter
+    ReleaseTransBufEntry(entryIdx);
+    return 0xffff;
   }
 
   transMap->bufEntry[entryIdx].slba = slba;
   transMap->bufEntry[entryIdx].requestId = requestId;
+  transMap->bufEntry[entryIdx].sqId = sqId;
   transMap->bufEntry[entryIdx].configured = 0;
   transMap->bufEntry[entryIdx].allocated = 1;
+  transMap->bufEntry[entryIdx].preload = 0;
+  transMap->bufEntry[entryIdx].preprocessed = 0;
+  transMap->bufEntry[entryIdx].configStarted = 0;
+  transMap->bufEntry[entryIdx].failed = 0;
+  transMap->bufEntry[entryIdx].retired = 0;
+  transMap->bufEntry[entryIdx].exactRead = 0;
+  transMap->bufEntry[entryIdx].fusedSectors = 0;
   transMap->bufEntry[entryIdx].nlbRequested = 0;
   transMap->bufEntry[entryIdx].nlbCompleted = 0;
   transMap->bufEntry[entryIdx].pagesTranslated = 0;
+  transMap->bufEntry[entryIdx].txDmaExe = 0;
+  transMap->bufEntry[entryIdx].chainNext = TRANS_CHAIN_NONE;
 
-  return entryIdx;
-}
-
-void DeallocateTransBufEntry(unsigned int entryIdx)
-{
-  XTime_GetTime(&transMap->bufEntry[entryIdx].requestCompleted);
-
-  transMap->bufEntry[entryIdx].prev = transAvailQ->tail;
-  transMap->bufEntry[entryIdx].next = 0xffff;
-  transMap->bufEntry[entryIdx].allocated = 0;
-  transMap->bufEntry[entryIdx].configured = 0;
-  if (transAvailQ->tail == 0xffff)
+  int anchor = TransRequestTagged(requestId) ? findTransBufEntry(requestId, sqId) : -1;
+  if (anchor >= 0)
   {
-    transAvailQ->head = entryIdx;
+    // Next segment of a chained request
+    ASSERT(transMap->bufEntry[anchor].chainOpen);
+    transMap->bufEntry[entryIdx].chainHead = anchor;
+    if (transMap->bufEntry[anchor].chainFront == TRANS_CHAIN_NONE)
+      transMap->bufEntry[anchor].chainFront = entryIdx;
+    else
+      transMap->bufEntry[transMap->bufEntry[anchor].chainTail].chainNext = entryIdx;
+    transMap->bufEntry[anchor].chainTail = entryIdx;
+    return entryIdx;
   }
-  else
+
+  transMap->bufEntry[entryIdx].chainHead = entryIdx;
+  transMap->bufEntry[entryIdx].chainFront = entryIdx;
+  transMap->bufEntry[entryIdx].chainTail = entryIdx;
+  transMap->bufEntry[entryIdx].chainSkipped = 0;
+  transMap->bufEntry[entryIdx].chainOpen = 0;
+
+  if (TransRequestTagged(requestId))
   {
-    transMap->bufEntry[transAvailQ->tail].next = entryIdx;
+    unsigned int bucket = TransTagBucket(requestId, sqId);
+    transMap->bufEntry[entryIdx].tagNext = transTags->bucket[bucket];
+    transTags->bucket[bucket] = entryIdx;
   }
-  transAvailQ->tail = entryIdx;
 
+  return entryIdx;
+}
+
+static void AccumulateTransTiming(unsigned int entryIdx)
+{
   // Update Aggregate Timing
   transStats->requestLatency += MICROSECONDS(
     (transMap->bufEntry[entryIdx].requestCompleted -
@@ -129,6 +233,8 @@ void DeallocateTransBufEntry(unsigned int entryIdx)
 	  			  transMap->bufEntry[entryIdx].translationStarted[page]));
 	  transStats->pages++;
   }
+  if (transMap->bufEntry[entryIdx].nlb == 0)
+    return;
   int sector;
   XTime minRequested = transMap->bufEntry[entryIdx].sectorRequested[0];
   XTime maxCompleted = transMap->bufEntry[entryIdx].sectorRequestCompleted[0];
@@ -152,139 +258,1062 @@ void DeallocateTransBufEntry(unsigned int entryIdx)
   transStats->totalReadLatency = MICROSECONDS((maxCompleted - minRequested));
 }
 
-void ConfigureTransBufEntry(unsigned int entryIdx)
+// Park the slot's scratchpad with its drain owner until its sends at txDmaTail are done
+static void StartTransDrain(unsigned int entryIdx)
 {
-	XTime_GetTime(&transMap->bufEntry[entryIdx].configWritten);
+  TransArenaMove(entryIdx, TRANS_ARENA_DRAIN_OWNER(entryIdx));
+  transMap->bufEntry[entryIdx].draining = 1;
+  transMap->bufEntry[entryIdx].drainTail = transMap->bufEntry[entryIdx].txDmaTail;
+  transMap->bufEntry[entryIdx].drainOverFlowCnt = transMap->bufEntry[entryIdx].txDmaOverFlowCnt;
+  transDrains++;
+}
 
-	struct transConfig* config = (struct transConfig*)(TRANS_CONFIG_ADDR + entryIdx * TRANS_CONFIG_SIZE);
+/*
+ * A segment is done: account its timing and give its arena space back, or
+ * park it with the slot's drain owner while its last result sectors are
+ * still being DMA'd to the host.
+ */
+static void RetireTransSegment(unsigned int entryIdx)
+{
+  XTime_GetTime(&transMap->bufEntry[entryIdx].requestCompleted);
 
-	/* Number of 4k logical blocks being returned. */
-	transMap->bufEntry[entryIdx].nlb = (config->resultEmbeddings * config->attributeSize * config->embeddingLength) / SECTOR_SIZE_FTL;
-	if ((config->resultEmbeddings * config->attributeSize * config->embeddingLength) % SECTOR_SIZE_FTL != 0) {
-		transMap->bufEntry[entryIdx].nlb += 1;
+  // Preloads aren't translation requests, keep them out of the request timing, failed ones too
+  if (!transMap->bufEntry[entryIdx].preload && !transMap->bufEntry[transMap->bufEntry[entryIdx].chainHead].failed)
+    AccumulateTransTiming(entryIdx);
+
+  if (transMap->bufEntry[entryIdx].txDmaExe &&
+      !check_auto_tx_dma_partial_done(transMap->bufEntry[entryIdx].txDmaTail,
+          transMap->bufEntry[entryIdx].txDmaOverFlowCnt))
+  {
+    /*
+     * One scratchpad drains per slot. If the one before is still being sent,
+     * this one stays with the slot, which isn't handed out again until
+     * ReapTransDrains has freed the older one.
+     */
+    if (transMap->bufEntry[entryIdx].draining)
+      transMap->bufEntry[entryIdx].drainQueued = 1;
+    else
+      StartTransDrain(entryIdx);
+  }
+  else
+  {
+    // The config, results and bookkeeping go back to the arena in one go
+    TransArenaFree(entryIdx);
+  }
+  transMap->bufEntry[entryIdx].txDmaExe = 0;
+  transMap->bufEntry[entryIdx].retired = 1;
+
+  // Waiting commands get another try
+  transAdmitQ->entryFreed = 1;
+}
+
+// Free the scratchpads whose TX DMAs have completed, called from the main loop
+void ReapTransDrains()
+{
+  unsigned int entryIdx;
+
+  if (!transDrains)
+    return;
+
+  for (entryIdx = 0; entryIdx < TRANS_BUF_ENTRY_NUM; entryIdx++)
+  {
+    if (!transMap->bufEntry[entryIdx].draining ||
+        !check_auto_tx_dma_partial_done(transMap->bufEntry[entryIdx].drainTail,
+            transMap->bufEntry[entryIdx].drainOverFlowCnt))
+      continue;
+
+    TransArenaFree(TRANS_ARENA_DRAIN_OWNER(entryIdx));
+    transMap->bufEntry[entryIdx].draining = 0;
+    transDrains--;
+    transAdmitQ->entryFreed = 1;
+
+    // The queued scratchpad drains next, its sends are at txDmaTail
+    if (transMap->bufEntry[entryIdx].drainQueued)
+    {
+      transMap->bufEntry[entryIdx].drainQueued = 0;
+      StartTransDrain(entryIdx);
+      if (!transMap->bufEntry[entryIdx].allocated)
+        AppendTransAvailQ(entryIdx);
+    }
+  }
+}
+
+static void ReleaseTransTag(unsigned int entryIdx)
+{
+  if (TransRequestTagged(transMap->bufEntry[entryIdx].requestId))
+  {
+    unsigned short* link = &transTags->bucket[TransTagBucket(transMap->bufEntry[entryIdx].requestId,
+        transMap->bufEntry[entryIdx].sqId)];
+    while (*link != entryIdx)
+      link = &transMap->bufEntry[*link].tagNext;
+    *link = transMap->bufEntry[entryIdx].tagNext;
+  }
+
+  ReleaseTransBufEntry(entryIdx);
+}
+
+void DeallocateTransBufEntry(unsigned int entryIdx)
+{
+  RetireTransSegment(entryIdx);
+  ReleaseTransTag(entryIdx);
+}
+
+/*
+ * Segments leave the chain in order so the result offsets of the ones behind
+ * stay put. The anchor keeps the tag until the last one is gone and no read
+ * still counts on the request's sectors.
+ */
+static void AdvanceTransChain(unsigned int anchor)
+{
+  unsigned int front;
+
+  while ((front = transMap->bufEntry[anchor].chainFront) != TRANS_CHAIN_NONE &&
+      transMap->bufEntry[front].configured &&
+      transMap->bufEntry[front].nlbCompleted == transMap->bufEntry[front].nlb)
+  {
+    transMap->bufEntry[anchor].chainSkipped += transMap->bufEntry[front].nlb;
+    transMap->bufEntry[anchor].chainFront = transMap->bufEntry[front].chainNext;
+    if (front != anchor)
+      ReleaseTransBufEntry(front);
+  }
+
+  if (front == TRANS_CHAIN_NONE && !transMap->bufEntry[anchor].chainOpen &&
+      transMap->bufEntry[anchor].nlbRequested <= transMap->bufEntry[anchor].chainSkipped &&
+      !transMap->bufEntry[anchor].exactRead)
+    ReleaseTransTag(anchor);
+}
+
+// All result sectors of a segment are sent, its arena space is freed right away
+static void CompleteTransSegment(unsigned int entryIdx)
+{
+  RetireTransSegment(entryIdx);
+  AdvanceTransChain(transMap->bufEntry[entryIdx].chainHead);
+}
+
+/*
+ * A failed request returns no results. Each of its segments is retired once
+ * none of its pages is in flight anymore, which may be long after the failure
+ * for segments which were already being walked or read.
+ */
+static void ReapFailedTransRequest(unsigned int anchor)
+{
+  unsigned int seg;
+
+  for (seg = transMap->bufEntry[anchor].chainFront; seg != TRANS_CHAIN_NONE; seg = transMap->bufEntry[seg].chainNext)
+  {
+    if (transMap->bufEntry[seg].retired || !transMap->bufEntry[seg].configured ||
+        transMap->bufEntry[seg].pagesTranslated != transMap->bufEntry[seg].nPages)
+      continue;
+
+    RetireTransSegment(seg);
+    // Done as far as the chain is concerned
+    transMap->bufEntry[seg].nlb = transMap->bufEntry[seg].nlbCompleted;
+  }
+
+  AdvanceTransChain(anchor);
+}
+
+/*
+ * The host sent a config this segment can't be run with, found before any of
+ * its pages was listed. The whole request fails: reads of it fail with
+ * INVALID_FIELD_IN_COMMAND, later segments are dropped as they come in.
+ */
+static void FailTransSegment(unsigned int entryIdx)
+{
+  unsigned int anchor = transMap->bufEntry[entryIdx].chainHead;
+
+  if (!transMap->bufEntry[anchor].failed)
+    transStats->failed_requests++;
+  transMap->bufEntry[anchor].failed = 1;
+
+  transMap->bufEntry[entryIdx].nlb = 0;
+  transMap->bufEntry[entryIdx].nPages = 0;
+  transMap->bufEntry[entryIdx].configured = 1;
+  ReapFailedTransRequest(anchor);
+}
+
+// Fail a read the request can't be served to, the request itself stays readable
+static void FailTransRead(unsigned int cmdSlotTag)
+{
+  NVME_COMPLETION nvmeCPL;
+
+  nvmeCPL.dword[0] = 0;
+  nvmeCPL.statusField.SCT = GENERIC_COMMAND_STATUS;
+  nvmeCPL.statusField.SC = INVALID_FIELD_IN_COMMAND;
+  nvmeCPL.statusField.DNR = 1;
+  nvmeCPL.specific = 0x0;
+  set_auto_nvme_cpl(cmdSlotTag, nvmeCPL.specific, nvmeCPL.statusFieldWord);
+}
+
+/*
+ * Segment holding result sector *sector of the request anchored at entryIdx,
+ * *sector is made relative to it. -1 while that segment isn't configured or
+ * hasn't been written yet, -2 if the request has no such sector or failed.
+ */
+static int FindResultSegment(unsigned int entryIdx, unsigned int* sector)
+{
+  unsigned int seg = transMap->bufEntry[entryIdx].chainFront;
+
+  if (transMap->bufEntry[entryIdx].failed)
+    return -2;
+
+  // Sectors of segments which left the chain have all been sent
+  *sector -= transMap->bufEntry[entryIdx].chainSkipped;
+  while (seg != TRANS_CHAIN_NONE)
+  {
+    if (!transMap->bufEntry[seg].configured)
+      return -1;
+    if (*sector < transMap->bufEntry[seg].nlb)
+      return seg;
+    *sector -= transMap->bufEntry[seg].nlb;
+    seg = transMap->bufEntry[seg].chainNext;
+  }
+
+  // Past the results of the last segment
+  return transMap->bufEntry[entryIdx].chainOpen ? -1 : -2;
+}
+
+static struct transPreloadTable* FindPreloadTable(struct transPreloadConfig* config, unsigned int tableID)
+{
+	static struct transPreloadTable registered;
+	const struct transTableInfo* table;
+	unsigned int i;
+
+	for (i = 0; i < config->tableNum; i++)
+		if (config->table[i].tableID == tableID)
+			return &config->table[i];
+
+	table = TransLookupTable(tableID);
+	if (!table)
+		return 0;
+
+	registered.tableID = tableID;
+	registered.slba = table->slba;
+	registered.attributeSize = table->attributeSize;
+	registered.embeddingLength = table->embeddingLength;
+	return &registered;
+}
+
+/*
+ * Carve the bookkeeping of a request out of one arena allocation: the result
+ * scratchpad and per-sector state for nlb sectors, per-result input counts,
+ * per-page state for at most pages pages and a unique table of at most uniques
+ * rows. Returns 0 if the arena can't hold it yet.
+ */
+static int AllocateTransMetadata(unsigned int entryIdx, unsigned int nlb, unsigned int results,
+		unsigned int pages, unsigned int uniques)
+{
+	unsigned int bytes = nlb * SECTOR_SIZE_FTL +
+			(2 * nlb + 3 * pages) * sizeof(XTime) +
+			(2 * nlb + results + 2 * pages + 1 + uniques) * sizeof(unsigned int);
+	unsigned int addr = TransArenaAlloc(entryIdx, bytes, 0);
+
+	if (!addr)
+		return 0;
+
+	// Block aligned results first, then 8B timing, then 4B counters
+	transMap->bufEntry[entryIdx].results = (float*)addr;
+	addr += nlb * SECTOR_SIZE_FTL;
+	transMap->bufEntry[entryIdx].sectorRequested = (XTime*)addr;
+	addr += nlb * sizeof(XTime);
+	transMap->bufEntry[entryIdx].sectorRequestCompleted = (XTime*)addr;
+	addr += nlb * sizeof(XTime);
+	transMap->bufEntry[entryIdx].flashReadStarted = (XTime*)addr;
+	addr += pages * sizeof(XTime);
+	transMap->bufEntry[entryIdx].translationStarted = (XTime*)addr;
+	addr += pages * sizeof(XTime);
+	transMap->bufEntry[entryIdx].translationCompleted = (XTime*)addr;
+	addr += pages * sizeof(XTime);
+	transMap->bufEntry[entryIdx].perResultSectorInputEmbeddings = (unsigned int*)addr;
+	addr += nlb * sizeof(unsigned int);
+	transMap->bufEntry[entryIdx].perResultSectorCompletedEmbeddings = (unsigned int*)addr;
+	addr += nlb * sizeof(unsigned int);
+	transMap->bufEntry[entryIdx].perResultInputCount = (unsigned int*)addr;
+	addr += results * sizeof(unsigned int);
+	transMap->bufEntry[entryIdx].perPageSLBAs = (unsigned int*)addr;
+	addr += pages * sizeof(unsigned int);
+	transMap->bufEntry[entryIdx].perPageUniqueStart = (unsigned int*)addr;
+	addr += (pages + 1) * sizeof(unsigned int);
+	transMap->bufEntry[entryIdx].uniquePairStart = (unsigned int*)addr;
+
+	return 1;
+}
+
+/*
+ * Build the page list of a preload. Rows which are already cached are pinned
+ * in place (or left alone by a warm-up), the others are the preload's unique
+ * rows, read page by page.
+ */
+static int ConfigurePreloadEntry(unsigned int entryIdx)
+{
+	struct transPreloadConfig* config = (struct transPreloadConfig*)transMap->bufEntry[entryIdx].configAddr;
+	struct transPreloadTable* table = 0;
+	unsigned int i, slba, rowBytes = 0, rowsPerPage = 0, nPages = 0, nUniques = 0;
+
+	// The preload command has completed already, a list which doesn't fit what was sent is dropped
+	if (config->tableNum > TRANS_PRELOAD_TABLE_NUM ||
+			config->rowNum > sizeof(config->rowList) / sizeof(config->rowList[0]) ||
+			TRANS_PRELOAD_HEADER_SIZE + config->rowNum * sizeof(config->rowList[0]) > transMap->bufEntry[entryIdx].configBytes)
+	{
+		transStats->failed_preloads++;
+		DeallocateTransBufEntry(entryIdx);
+		return 1;
 	}
-	unsigned i;
-	for (i = 0; i < transMap->bufEntry[entryIdx].nlb; i++)
+
+	transMap->bufEntry[entryIdx].nlb = 0;
+	if (!AllocateTransMetadata(entryIdx, 0, 0, config->rowNum, config->rowNum))
+		return 0;
+
+	if (config->flags & TRANS_PRELOAD_UNPIN_ALL)
+		TransCacheUnpinAll();
+
+	for (i = 0; i < config->rowNum; i++)
 	{
-		transMap->bufEntry[entryIdx].perResultSectorCompletedEmbeddings[i] = 0;
-		transMap->bufEntry[entryIdx].perResultSectorInputEmbeddings[i] = 0;
+		struct transPreloadRow row = config->rowList[i];
+		if (!table || table->tableID != row.tableID)
+		{
+			// Rows of an unknown table, or one in a format without a kernel, are skipped
+			table = FindPreloadTable(config, row.tableID);
+			rowsPerPage = 0;
+			if (table && SelectTransKernel(TRANS_POOL_SUM, TransAttributeType(table->attributeSize), table->embeddingLength))
+			{
+				rowBytes = TransRowBytes(TransAttributeType(table->attributeSize), table->embeddingLength);
+				rowsPerPage = rowBytes ? PAGE_SIZE / rowBytes : 0;
+			}
+		}
+		if (!rowsPerPage)
+		{
+			transStats->skipped_preload_rows++;
+			continue;
+		}
+
+		if ((config->flags & TRANS_PRELOAD_WARM) ? TransCacheCached(row.tableID, row.rowID, rowBytes) :
+				TransCachePin(row.tableID, row.rowID, rowBytes))
+			continue;
+
+		slba = table->slba + (row.rowID / rowsPerPage) * SECTOR_NUM_PER_PAGE;
+		if (nPages == 0 || transMap->bufEntry[entryIdx].perPageSLBAs[nPages - 1] != slba)
+		{
+			transMap->bufEntry[entryIdx].perPageSLBAs[nPages] = slba;
+			transMap->bufEntry[entryIdx].perPageUniqueStart[nPages] = nUniques;
+			nPages++;
+		}
+		transMap->bufEntry[entryIdx].uniquePairStart[nUniques++] = i;
+	}
+	transMap->bufEntry[entryIdx].perPageUniqueStart[nPages] = nUniques;
+	transMap->bufEntry[entryIdx].nPages = nPages;
+	transMap->bufEntry[entryIdx].configured = 1;
+
+	XTime_GetTime(&transMap->bufEntry[entryIdx].configProcessed);
+
+	if (nPages == 0)
+		DeallocateTransBufEntry(entryIdx);
+
+	return 1;
+}
+
+// Pin (or just insert, for a warm-up) the preloaded rows of a page read from flash
+static void translatePreloadPage(unsigned int entryIdx, void* devAddr, unsigned int pageIdx)
+{
+	struct transPreloadConfig* config = (struct transPreloadConfig*)transMap->bufEntry[entryIdx].configAddr;
+	unsigned int unique = transMap->bufEntry[entryIdx].perPageUniqueStart[pageIdx];
+	unsigned int lastUnique = transMap->bufEntry[entryIdx].perPageUniqueStart[pageIdx + 1];
+	struct transPreloadTable* table =
+			FindPreloadTable(config, config->rowList[transMap->bufEntry[entryIdx].uniquePairStart[unique]].tableID);
+	unsigned int attributeType = TransAttributeType(table->attributeSize);
+	unsigned int rowBytes = TransRowBytes(attributeType, table->embeddingLength);
+	const struct transKernel* kernel = SelectTransKernel(TRANS_POOL_SUM, attributeType, table->embeddingLength);
+	unsigned int base_embedding_id = ((transMap->bufEntry[entryIdx].perPageSLBAs[pageIdx] - table->slba) / SECTOR_NUM_PER_PAGE) *
+			(PAGE_SIZE / rowBytes);
+	unsigned int cache_line, rowID;
+
+	for (; unique < lastUnique; unique++)
+	{
+		rowID = config->rowList[transMap->bufEntry[entryIdx].uniquePairStart[unique]].rowID;
+		cache_line = TransCacheInsert(table->tableID, rowID, rowBytes, !(config->flags & TRANS_PRELOAD_WARM));
+		if (cache_line != TRANS_EMBED_CACHE_MISS)
+			kernel->copy(TRANS_CACHE_ROW(cache_line),
+					(unsigned char*)devAddr + (rowID - base_embedding_id) * rowBytes, table->embeddingLength);
+	}
+
+	if (++transMap->bufEntry[entryIdx].pagesTranslated == transMap->bufEntry[entryIdx].nPages)
+		DeallocateTransBufEntry(entryIdx);
+}
+
+/*
+ * Device side ID preprocessing, run before the page list is built. Raw
+ * feature IDs are mapped into the table first (idTransform). Then the pairs
+ * are radix sorted by ID, weights moving with their pair. Sorting by ID
+ * buckets the pairs by flash page and makes repeats of a row adjacent, so
+ * every page is read once and every row decoded once whatever order the
+ * host sent. Lists which are already sorted are left alone. Returns 0 if the
+ * list can't be preprocessed.
+ */
+static int PreprocessEmbeddingIDs(struct transConfig* config)
+{
+	struct embeddingIDPair* srcPairs = config->embeddingIDList;
+	struct embeddingIDPair* dstPairs = (struct embeddingIDPair*)TRANS_SORT_BUF_ADDR;
+	struct embeddingIDPair* tmpPairs;
+	float* srcWeights = TRANS_CONFIG_WEIGHTS(config);
+	float* dstWeights = (float*)(dstPairs + config->inputEmbeddings);
+	float* tmpWeights;
+	int weighted = (config->poolOperator == TRANS_POOL_WEIGHTED_SUM);
+	unsigned int bucket[TRANS_SORT_RADIX];
+	unsigned int i, shift, digit, pos, count, maxID = 0, sorted = 1;
+
+	if (config->idTransform >= TRANS_ID_TRANSFORM_NUM ||
+			(config->idTransform != TRANS_ID_RAW && !config->tableRows) ||
+			config->inputEmbeddings > TRANS_MAX_INPUT_EMBEDDINGS)
+		return 0;
+
+	for (i = 0; i < config->inputEmbeddings; i++)
+	{
+		// Results are pooled into by index
+		if (srcPairs[i].result >= config->resultEmbeddings)
+			return 0;
+
+		if (config->idTransform == TRANS_ID_MODULO)
+			srcPairs[i].embeddingID %= config->tableRows;
+		else if (config->idTransform == TRANS_ID_HASH)
+			srcPairs[i].embeddingID = TransHashID(srcPairs[i].embeddingID) % config->tableRows;
+
+		if (srcPairs[i].embeddingID > maxID)
+			maxID = srcPairs[i].embeddingID;
+		if (i && srcPairs[i].embeddingID < srcPairs[i - 1].embeddingID)
+			sorted = 0;
 	}
+	if (sorted)
+		return 1;
 
-	unsigned int embedding_index = 0;
-	unsigned int result_sector;
-	unsigned int page_index = 0;
-	unsigned page_id = ((config->embeddingIDList[0].embeddingID) * config->attributeSize * config->embeddingLength) / PAGE_SIZE;
-	unsigned cur_page_id = page_id;
-	unsigned cur_page_input_length = 0;
-	transMap->bufEntry[entryIdx].perPageSLBAs[page_index] =
-						transMap->bufEntry[entryIdx].slba + (cur_page_id * SECTOR_NUM_PER_PAGE);
-	transMap->bufEntry[entryIdx].perPageStartingIndex[page_index] = embedding_index;
-	for (embedding_index = 0; embedding_index < config->inputEmbeddings; embedding_index++)
+	for (shift = 0; shift < 32 && (maxID >> shift); shift += TRANS_SORT_RADIX_BITS)
 	{
-		struct embeddingIDPair eID = config->embeddingIDList[embedding_index];
-		result_sector = (eID.result * (config->embeddingLength * config->attributeSize)) / SECTOR_SIZE_FTL;
+		for (digit = 0; digit < TRANS_SORT_RADIX; digit++)
+			bucket[digit] = 0;
+		for (i = 0; i < config->inputEmbeddings; i++)
+			bucket[(srcPairs[i].embeddingID >> shift) & (TRANS_SORT_RADIX - 1)]++;
+		for (digit = 0, pos = 0; digit < TRANS_SORT_RADIX; digit++)
+		{
+			count = bucket[digit];
+			bucket[digit] = pos;
+			pos += count;
+		}
+		for (i = 0; i < config->inputEmbeddings; i++)
+		{
+			pos = bucket[(srcPairs[i].embeddingID >> shift) & (TRANS_SORT_RADIX - 1)]++;
+			dstPairs[pos] = srcPairs[i];
+			if (weighted)
+				dstWeights[pos] = srcWeights[i];
+		}
+
+		tmpPairs = srcPairs; srcPairs = dstPairs; dstPairs = tmpPairs;
+		tmpWeights = srcWeights; srcWeights = dstWeights; dstWeights = tmpWeights;
+	}
+
+	// Odd number of passes, the sorted list is in the sort buffer
+	if (srcPairs != config->embeddingIDList)
+		for (i = 0; i < config->inputEmbeddings; i++)
+		{
+			dstPairs[i] = srcPairs[i];
+			if (weighted)
+				dstWeights[i] = srcWeights[i];
+		}
+
+	return 1;
+}
+
+// Pair after the last repeat of the row at pair, the list is sorted so repeats are adjacent
+static unsigned int NextUniquePair(struct transConfig* config, unsigned int pair)
+{
+	unsigned int embeddingID = config->embeddingIDList[pair].embeddingID;
+
+	while (++pair < config->inputEmbeddings && config->embeddingIDList[pair].embeddingID == embeddingID);
+
+	return pair;
+}
+
+/*
+ * Accumulate one stored row into the result of every pair in [pair, lastPair),
+ * which all use that row. A quantized row used more than once is decoded to
+ * fp32 a single time and the decoded copy is pooled instead.
+ */
+static void ScatterRow(unsigned int entryIdx, struct transConfig* config, const void* row,
+		unsigned int pair, unsigned int lastPair)
+{
+	const struct transKernel* kernel = transMap->bufEntry[entryIdx].kernel;
+	float* toBase = transMap->bufEntry[entryIdx].results;
+	float* weights = TRANS_CONFIG_WEIGHTS(config);
+	float* decodedRow = (float*)TRANS_DECODED_ROW_ADDR;
+	int weighted = (config->poolOperator == TRANS_POOL_WEIGHTED_SUM);
+	unsigned int atr;
+
+	if (lastPair - pair > 1 && transMap->bufEntry[entryIdx].decodeKernel)
+	{
+		for (atr = 0; atr < config->embeddingLength; atr++)
+			decodedRow[atr] = 0.0f;
+		transMap->bufEntry[entryIdx].decodeKernel->pool(decodedRow, row, config->embeddingLength, 1.0f);
+		row = decodedRow;
+		kernel = transMap->bufEntry[entryIdx].decodedKernel;
+	}
+
+	for (; pair < lastPair; pair++)
+		kernel->pool(toBase + (config->embeddingIDList[pair].result * config->embeddingLength), row,
+				config->embeddingLength, weighted ? weights[pair] : 1.0f);
+}
+
+/*
+ * Expand a TRANS_CONFIG_FORMAT_CSR config into the pair format, in a new
+ * arena allocation which becomes the entry's config. Returns 0 if the arena
+ * can't hold it yet, -1 if the encoding is malformed.
+ */
+static int DecodeCSRConfig(unsigned int entryIdx)
+{
+	struct transConfig* csr = (struct transConfig*)transMap->bufEntry[entryIdx].configAddr;
+	unsigned int* offsets = (unsigned int*)csr->embeddingIDList;
+	unsigned char* ids = (unsigned char*)(offsets + csr->resultEmbeddings);
+	unsigned char* end = (unsigned char*)csr + transMap->bufEntry[entryIdx].configBytes;
+	int weighted = (csr->poolOperator == TRANS_POOL_WEIGHTED_SUM);
+	unsigned int i, bag = 0, id = 0, value, shift, byte;
+
+	if (csr->inputEmbeddings > TRANS_MAX_INPUT_EMBEDDINGS ||
+			csr->resultEmbeddings > (transMap->bufEntry[entryIdx].configBytes - TRANS_CONFIG_HEADER_SIZE) / sizeof(unsigned int) ||
+			(csr->resultEmbeddings && offsets[0] != 0))
+		return -1;
+
+	unsigned int addr = TransArenaAlloc(entryIdx, TRANS_CONFIG_HEADER_SIZE +
+			csr->inputEmbeddings * (sizeof(struct embeddingIDPair) + (weighted ? sizeof(float) : 0)), 0);
+	if (!addr)
+		return 0;
+	struct transConfig* config = (struct transConfig*)addr;
+
+	for (i = 0; i < TRANS_CONFIG_HEADER_SIZE / sizeof(unsigned int); i++)
+		((unsigned int*)config)[i] = ((unsigned int*)csr)[i];
+
+	for (i = 0; i < csr->inputEmbeddings; i++)
+	{
+		// Next bag, skipping empty ones
+		while (bag + 1 < csr->resultEmbeddings && offsets[bag + 1] <= i)
+		{
+			if (offsets[bag + 1] < offsets[bag])
+				return -1;
+			bag++;
+			id = 0;
+		}
+
+		value = 0;
+		shift = 0;
+		do
+		{
+			if (ids == end)
+				return -1;
+			byte = *ids++;
+			value |= (byte & 0x7f) << shift;
+			shift += 7;
+		} while (byte & 0x80);
+		id += (value >> 1) ^ -(value & 1);
+
+		config->embeddingIDList[i].result = bag;
+		config->embeddingIDList[i].embeddingID = id;
+	}
+
+	if (weighted)
+	{
+		float* weights = (float*)(((unsigned int)ids + 3) & ~0x3);
+		if ((unsigned char*)(weights + csr->inputEmbeddings) > end)
+			return -1;
+		for (i = 0; i < csr->inputEmbeddings; i++)
+			TRANS_CONFIG_WEIGHTS(config)[i] = weights[i];
+	}
+
+	// The encoded config stays in the arena until the entry is freed
+	transMap->bufEntry[entryIdx].configAddr = addr;
+	transMap->bufEntry[entryIdx].configFormat = TRANS_CONFIG_FORMAT_PAIRS;
+	return 1;
+}
+
+/*
+ * Walk the next TRANS_CONFIG_SLICE distinct IDs of the sorted config: hits are
+ * pooled from the cache right away, misses extend the page list. Every page but
+ * the last one listed so far is complete and may already be read from flash,
+ * so a long config does not hold up the scheduler or its own first page reads.
+ */
+static void ScanTransConfig(unsigned int entryIdx)
+{
+	struct transConfig* config = (struct transConfig*)transMap->bufEntry[entryIdx].configAddr;
+	unsigned int rowsPerPage = transMap->bufEntry[entryIdx].rowsPerPage;
+	unsigned int rowBytes = transMap->bufEntry[entryIdx].rowBytes;
+	unsigned int resultBytes = config->embeddingLength * sizeof(float);
+	unsigned int embedding_index = transMap->bufEntry[entryIdx].configCursor, last_index, i, slice;
+	unsigned int page_slba, nPages = transMap->bufEntry[entryIdx].nPages;
+	unsigned int nUniques = transMap->bufEntry[entryIdx].configUniques;
+
+	for (slice = 0; slice < TRANS_CONFIG_SLICE && embedding_index < config->inputEmbeddings;
+			slice++, embedding_index = last_index)
+	{
+		unsigned int embeddingID = config->embeddingIDList[embedding_index].embeddingID;
+		last_index = NextUniquePair(config, embedding_index);
+
+		if (TransPoolNeedsFinalize(config->poolOperator))
+			for (i = embedding_index; i < last_index; i++)
+				transMap->bufEntry[entryIdx].perResultInputCount[config->embeddingIDList[i].result]++;
 
 		// Cache FastPath
-		unsigned int fullindex = (eID.embeddingID << 5) | config->tableID;
-		unsigned int cache_index = fullindex & ((0x1 << 20)-1);
-		unsigned int tag = (fullindex >> 20) & ((0x1 << 12)-1);
-		//xil_printf("embedding_index (%d), eID.embeddingID (%d), fullindex (%x), cache_index (%x), tag (%x), entryIdx (%d), eID.result (%d).\r\n",
-				//embedding_index, eID.embeddingID, fullindex, cache_index, tag, entryIdx, eID.result);
-		if (transCache->cacheEntry[cache_index].valid &&
-			transCache->cacheEntry[cache_index].tag == tag) {
-
-			float* fromAtr = (float*)transCache->cacheEntry[cache_index].embedding_bytes;
-			float* toBase = (float*)(TRANS_BUF_ADDR + entryIdx * TRANS_BUF_ENTRY_SIZE);
-			float* toAtr = toBase + (eID.result * config->embeddingLength);
-			int k = 0;
-	        for (k = 0; k < config->embeddingLength; k++)
-			{
-				// Assume for now attribute size is 4 and embedding entries are floats
-				*((float*)toAtr) += *((float*)fromAtr);
-				toAtr++;
-				fromAtr++;
-			}
-	        transStats->cache_hits++;
+		const unsigned char* cached_row = transMap->bufEntry[entryIdx].cacheable ?
+				TransCacheLookup(config->tableID, embeddingID, rowBytes) : 0;
+		if (cached_row) {
+			ScatterRow(entryIdx, config, cached_row, embedding_index, last_index);
+			transStats->cache_hits++;
 			continue;
 		}
 		transStats->cache_misses++;
 		// END FastPath -- Make sure embedding is processed from Flash
 
-		transMap->bufEntry[entryIdx].perResultSectorInputEmbeddings[result_sector] += 1;
+		for (i = embedding_index; i < last_index; i++)
+			transMap->bufEntry[entryIdx].perResultSectorInputEmbeddings[
+					(config->embeddingIDList[i].result * resultBytes) / SECTOR_SIZE_FTL]++;
 
-		cur_page_id = (eID.embeddingID * config->attributeSize * config->embeddingLength) / PAGE_SIZE;
-		if (cur_page_id != page_id) {
-			page_index++;
-			transMap->bufEntry[entryIdx].perPageSLBAs[page_index] =
-					transMap->bufEntry[entryIdx].slba + (cur_page_id * SECTOR_NUM_PER_PAGE);
-			transMap->bufEntry[entryIdx].perPageStartingIndex[page_index] = embedding_index;
-			transMap->bufEntry[entryIdx].perPageInputLength[page_index - 1] = cur_page_input_length;
-			cur_page_input_length = 0;
+		page_slba = transMap->bufEntry[entryIdx].slba + (embeddingID / rowsPerPage) * SECTOR_NUM_PER_PAGE;
+		if (nPages == 0 || transMap->bufEntry[entryIdx].perPageSLBAs[nPages - 1] != page_slba)
+		{
+			transMap->bufEntry[entryIdx].perPageSLBAs[nPages] = page_slba;
+			transMap->bufEntry[entryIdx].perPageUniqueStart[nPages] = nUniques;
+			nPages++;
 		}
-		page_id = cur_page_id;
-		cur_page_input_length++;
+		transMap->bufEntry[entryIdx].uniquePairStart[nUniques++] = embedding_index;
 	}
-	transMap->bufEntry[entryIdx].perPageInputLength[page_index] = cur_page_input_length;
-	transMap->bufEntry[entryIdx].nPages = page_index + 1;
+	transMap->bufEntry[entryIdx].configCursor = embedding_index;
+	transMap->bufEntry[entryIdx].configUniques = nUniques;
+	transMap->bufEntry[entryIdx].nPages = nPages;
+	if (embedding_index < config->inputEmbeddings)
+		return;
+
+	transMap->bufEntry[entryIdx].perPageUniqueStart[nPages] = nUniques;
+	transMap->bufEntry[entryIdx].configured = 1;
+
+	XTime_GetTime(&transMap->bufEntry[entryIdx].configProcessed);
+
+	if (transMap->bufEntry[transMap->bufEntry[entryIdx].chainHead].failed)
+		ReapFailedTransRequest(transMap->bufEntry[entryIdx].chainHead);
+}
 
-	/* TODO -- 'Zero' out results pages. Assume floats for now. */
-	float *resultsBase = (float*)(TRANS_BUF_ADDR + entryIdx * TRANS_BUF_ENTRY_SIZE);
-	for(i = 0; i < config->resultEmbeddings * config->attributeSize * config->embeddingLength; i++)
+/*
+ * Returns 0 if the arena has no room for the request's bookkeeping yet, the
+ * caller retries on a later pass.
+ */
+int ConfigureTransBufEntry(unsigned int entryIdx)
+{
+	if (transMap->bufEntry[entryIdx].preload)
 	{
-		*resultsBase = 0;
+		XTime_GetTime(&transMap->bufEntry[entryIdx].configWritten);
+		return ConfigurePreloadEntry(entryIdx);
+	}
+
+	// Setup is done, keep walking the ID list
+	if (transMap->bufEntry[entryIdx].configStarted)
+	{
+		ScanTransConfig(entryIdx);
+		return 1;
+	}
+
+	// Another segment of the request was rejected, nothing of it will be read
+	if (transMap->bufEntry[transMap->bufEntry[entryIdx].chainHead].failed)
+	{
+		FailTransSegment(entryIdx);
+		return 1;
+	}
+
+	struct transConfig* config;
+	const struct transTableInfo* table = &transMap->bufEntry[entryIdx].table;
+	if (!transMap->bufEntry[entryIdx].preprocessed)
+	{
+		int valid;
+
+		XTime_GetTime(&transMap->bufEntry[entryIdx].configWritten);
+		config = (struct transConfig*)transMap->bufEntry[entryIdx].configAddr;
+		if (transMap->bufEntry[entryIdx].configFormat == TRANS_CONFIG_FORMAT_CSR)
+		{
+			valid = DecodeCSRConfig(entryIdx);
+			if (!valid)
+				return 0;
+			config = (struct transConfig*)transMap->bufEntry[entryIdx].configAddr;
+		}
+		else
+		{
+			// The ID list (and weights) must lie within the config the host sent
+			valid = config->inputEmbeddings <= TRANS_MAX_INPUT_EMBEDDINGS &&
+					TRANS_CONFIG_HEADER_SIZE + config->inputEmbeddings * (sizeof(struct embeddingIDPair) +
+					(config->poolOperator == TRANS_POOL_WEIGHTED_SUM ? sizeof(float) : 0)) <=
+					transMap->bufEntry[entryIdx].configBytes;
+		}
+
+		// The host only names the table, its format comes from the registry
+		config->tableID = transMap->bufEntry[entryIdx].tableHandle;
+		config->attributeSize = table->attributeSize;
+		config->embeddingLength = table->embeddingLength;
+		config->idTransform = table->idTransform;
+		config->tableRows = table->rows;
+
+		if (valid <= 0 || !PreprocessEmbeddingIDs(config))
+		{
+			FailTransSegment(entryIdx);
+			return 1;
+		}
+		transMap->bufEntry[entryIdx].preprocessed = 1;
+	}
+	config = (struct transConfig*)transMap->bufEntry[entryIdx].configAddr;
+
+	/* Pick the pooling kernel once for the whole request, none for an unknown operator. */
+	transMap->bufEntry[entryIdx].kernel =
+			SelectTransKernel(config->poolOperator, TransAttributeType(config->attributeSize), config->embeddingLength);
+	if (!transMap->bufEntry[entryIdx].kernel)
+	{
+		FailTransSegment(entryIdx);
+		return 1;
+	}
+	const struct transKernel* kernel = transMap->bufEntry[entryIdx].kernel;
+
+	/* Quantized rows used by several bags are decoded once, see ScatterRow. */
+	transMap->bufEntry[entryIdx].decodeKernel = 0;
+	transMap->bufEntry[entryIdx].decodedKernel = 0;
+	if (TransAttributeType(config->attributeSize) != TRANS_ATTR_FP32 &&
+			config->embeddingLength * sizeof(float) <= TRANS_DECODED_ROW_SIZE)
+	{
+		transMap->bufEntry[entryIdx].decodeKernel =
+				SelectTransKernel(TRANS_POOL_SUM, TransAttributeType(config->attributeSize), config->embeddingLength);
+		transMap->bufEntry[entryIdx].decodedKernel =
+				SelectTransKernel(config->poolOperator, TRANS_ATTR_FP32, config->embeddingLength);
+	}
+
+	/* Page geometry was worked out when the table was registered. */
+	unsigned int rowBytes = table->rowBytes;
+	unsigned int rowsPerPage = table->rowsPerPage;
+	transMap->bufEntry[entryIdx].rowBytes = rowBytes;
+	transMap->bufEntry[entryIdx].rowsPerPage = rowsPerPage;
+	int cacheable = (rowBytes <= TRANS_EMBED_CACHE_MAX_ROW_BYTES && table->cachePolicy != TRANS_TABLE_CACHE_NONE);
+	transMap->bufEntry[entryIdx].cacheable = cacheable;
+
+	/* Number of 4k logical blocks being returned. Results are always fp32. */
+	unsigned int resultBytes = config->embeddingLength * sizeof(float);
+	transMap->bufEntry[entryIdx].nlb = (config->resultEmbeddings * resultBytes) / SECTOR_SIZE_FTL;
+	if ((config->resultEmbeddings * resultBytes) % SECTOR_SIZE_FTL != 0) {
+		transMap->bufEntry[entryIdx].nlb += 1;
+	}
+
+	// More results than a scratchpad holds, or not as many as a fused command made room for
+	if (config->resultEmbeddings > TRANS_SCRATCHPAD_SIZE / resultBytes || (transMap->bufEntry[entryIdx].fusedSectors &&
+			transMap->bufEntry[entryIdx].fusedSectors != transMap->bufEntry[entryIdx].nlb))
+	{
+		FailTransSegment(entryIdx);
+		return 1;
+	}
+
+	/* Size the bookkeeping by the distinct rows and pages of the request. */
+	unsigned i, pageBound = 0, uniqueBound = 0;
+	for (i = 0; i < config->inputEmbeddings; i++)
+	{
+		if (i && config->embeddingIDList[i].embeddingID == config->embeddingIDList[i - 1].embeddingID)
+			continue;
+		uniqueBound++;
+		if (i == 0 || config->embeddingIDList[i].embeddingID / rowsPerPage !=
+				config->embeddingIDList[i - 1].embeddingID / rowsPerPage)
+			pageBound++;
+	}
+	if (!AllocateTransMetadata(entryIdx, transMap->bufEntry[entryIdx].nlb, config->resultEmbeddings,
+			pageBound, uniqueBound))
+		return 0;
+
+	for (i = 0; i < transMap->bufEntry[entryIdx].nlb; i++)
+	{
+		transMap->bufEntry[entryIdx].perResultSectorCompletedEmbeddings[i] = 0;
+		transMap->bufEntry[entryIdx].perResultSectorInputEmbeddings[i] = 0;
+	}
+
+	/*
+	 * Set results pages to the operator's identity before the cache fast path
+	 * starts accumulating into them.
+	 */
+	float *resultsBase = transMap->bufEntry[entryIdx].results;
+	for(i = 0; i < config->resultEmbeddings * config->embeddingLength; i++)
+	{
+		*resultsBase = kernel->identity;
 		resultsBase++;
 	}
+	if (TransPoolNeedsFinalize(config->poolOperator))
+		for (i = 0; i < config->resultEmbeddings; i++)
+			transMap->bufEntry[entryIdx].perResultInputCount[i] = 0;
 
-	transMap->bufEntry[entryIdx].configured = 1;
+	transMap->bufEntry[entryIdx].nPages = 0;
+	transMap->bufEntry[entryIdx].configCursor = 0;
+	transMap->bufEntry[entryIdx].configUniques = 0;
+	transMap->bufEntry[entryIdx].configStarted = 1;
 
-	XTime_GetTime(&transMap->bufEntry[entryIdx].configProcessed);
+	ScanTransConfig(entryIdx);
+	return 1;
 }
 
-unsigned int readTranslatedPagesNonBlocking(unsigned int entryIdx, unsigned int firstSector, unsigned int nextSector, unsigned int requestedSectors, unsigned int cmdSlotTag)
+/*
+ * Apply the per-result part of MEAN and MAX once every input of a result sector
+ * has been pooled: MEAN divides by the bag size, and empty bags return zeros
+ * rather than the MAX identity. Works per attribute, so a result straddling two
+ * sectors is finalized exactly once.
+ */
+static void FinalizeResultSector(unsigned int entryIdx, unsigned int sector)
 {
-	unsigned int sectorNum, curSector;
-	int nlbRequested = 0;
+	struct transConfig* config = (struct transConfig*)transMap->bufEntry[entryIdx].configAddr;
+	float* results = transMap->bufEntry[entryIdx].results;
+	unsigned int atr, lastAtr, result, count;
+
+	if (!TransPoolNeedsFinalize(config->poolOperator))
+		return;
 
-	if (!transMap->bufEntry[entryIdx].configured) return nlbRequested;
+	atr = sector * (SECTOR_SIZE_FTL / sizeof(float));
+	lastAtr = atr + (SECTOR_SIZE_FTL / sizeof(float));
+	if (lastAtr > config->resultEmbeddings * config->embeddingLength)
+		lastAtr = config->resultEmbeddings * config->embeddingLength;
+
+	for (; atr < lastAtr; atr++)
+	{
+		result = atr / config->embeddingLength;
+		count = transMap->bufEntry[entryIdx].perResultInputCount[result];
+		if (count == 0)
+			results[atr] = 0.0f;
+		else if (config->poolOperator == TRANS_POOL_MEAN)
+			results[atr] /= (float)count;
+	}
+}
+
+/*
+ * Sectors are numbered across the segments of a chained request (see
+ * FindResultSegment), entryIdx is its anchor. Returns the number of sectors
+ * sent, or -1 if the read ran past the request's results and was failed.
+ */
+int readTranslatedPagesNonBlocking(unsigned int entryIdx, unsigned int firstSector, unsigned int nextSector, unsigned int requestedSectors,
+		unsigned int cmdSlotTag, XTime requested)
+{
+	unsigned int sectorNum, curSector, sector;
+	int nlbRequested = 0, seg;
 
 	for (sectorNum = 0;
 		 sectorNum < requestedSectors;
 		 sectorNum++)
 	{
 		curSector = nextSector + sectorNum;
+		sector = curSector;
+		seg = FindResultSegment(entryIdx, &sector);
+		if (seg == -2)
+		{
+			// The sectors the read claimed but won't get no longer hold the request
+			FailTransRead(cmdSlotTag);
+			transMap->bufEntry[entryIdx].nlbRequested -= requestedSectors - sectorNum;
+			AdvanceTransChain(entryIdx);
+			return -1;
+		}
+		if (seg < 0)
+			return nlbRequested;
 
-		if (transMap->bufEntry[entryIdx].perResultSectorCompletedEmbeddings[curSector] <
-				transMap->bufEntry[entryIdx].perResultSectorInputEmbeddings[curSector])
+		if (transMap->bufEntry[seg].perResultSectorCompletedEmbeddings[sector] <
+				transMap->bufEntry[seg].perResultSectorInputEmbeddings[sector])
 		{
 			return nlbRequested;
 		}
 		else
 		{
-			transMap->bufEntry[entryIdx].perResultSectorCompletedEmbeddings[curSector] = 0;
+			transMap->bufEntry[seg].perResultSectorCompletedEmbeddings[sector] = 0;
 			nlbRequested++;
 		}
 
-		set_auto_tx_dma(cmdSlotTag, (curSector - firstSector), TRANS_BUF_ADDR + entryIdx * TRANS_BUF_ENTRY_SIZE + curSector * SECTOR_SIZE_FTL);
+		FinalizeResultSector(seg, sector);
+
+		// The arena is cached, write the sector back before the DMA reads DRAM
+		Xil_DCacheFlushRange((unsigned int)transMap->bufEntry[seg].results + sector * SECTOR_SIZE_FTL, SECTOR_SIZE_FTL);
+		set_auto_tx_dma(cmdSlotTag, (curSector - firstSector), (unsigned int)transMap->bufEntry[seg].results + sector * SECTOR_SIZE_FTL);
 
-		XTime_GetTime(&transMap->bufEntry[entryIdx].sectorRequestCompleted[curSector]);
+		// The scratchpad is kept until this DMA is done, see RetireTransSegment
+		transMap->bufEntry[seg].txDmaExe = 1;
+		transMap->bufEntry[seg].txDmaTail = g_hostDmaStatus.fifoTail.autoDmaTx;
+		transMap->bufEntry[seg].txDmaOverFlowCnt = g_hostDmaAssistStatus.autoDmaTxOverFlowCnt;
 
-		/* TODO - properly save the txdma tail such that this buffer space isn't allocated again until
-		 * all the data has been sent.
-		 */
+		transMap->bufEntry[seg].sectorRequested[sector] = requested;
+		XTime_GetTime(&transMap->bufEntry[seg].sectorRequestCompleted[sector]);
 
-		if (++transMap->bufEntry[entryIdx].nlbCompleted == transMap->bufEntry[entryIdx].nlb)
-			DeallocateTransBufEntry(entryIdx);
+		if (++transMap->bufEntry[seg].nlbCompleted == transMap->bufEntry[seg].nlb)
+			CompleteTransSegment(seg);
 	}
 
 	return nlbRequested;
 }
 
+/*
+ * Host address of byte offset of an exact read's buffer. The first page is
+ * PRP1 (with its offset), the next is PRP2 or, for more than two pages, the
+ * entries of the PRP list PRP2 points at.
+ */
+static void ExactReadHostAddr(struct transReqEntry* read, unsigned int offset, unsigned int* addrL, unsigned int* addrH)
+{
+	unsigned int hostOffset = offset + (read->prp[0] & 0xfff);
+	unsigned int page = hostOffset / 0x1000;
+
+	if (page == 0)
+	{
+		*addrL = read->prp[0] + offset;
+		*addrH = read->prp[1];
+	}
+	else if (!read->prpList)
+	{
+		ASSERT(page == 1);
+		*addrL = read->prp[2] + (hostOffset & 0xfff);
+		*addrH = read->prp[3];
+	}
+	else
+	{
+		*addrL = ((unsigned int*)read->prpList)[(page - 1) * 2] + (hostOffset & 0xfff);
+		*addrH = ((unsigned int*)read->prpList)[(page - 1) * 2 + 1];
+	}
+}
+
+// The exact read fails and lets go of the request
+static int FailExactTransRead(struct transReqEntry* read)
+{
+	FailTransRead(read->cmdSlotTag);
+	transMap->bufEntry[read->entryIdx].exactRead = 0;
+	AdvanceTransChain(read->entryIdx);
+	return 1;
+}
+
+/*
+ * Fetch n PRP entries from host address addrH:addrL, within one host page,
+ * to devAddr.
+ */
+static void FetchPrpEntries(unsigned int devAddr, unsigned int addrH, unsigned int addrL, unsigned int n)
+{
+	unsigned int bytes = n * 2 * sizeof(unsigned int);
+
+	Xil_DCacheInvalidateRange(devAddr, bytes);
+	set_direct_rx_dma(devAddr, addrH, addrL, bytes);
+	check_direct_rx_dma_done();
+	Xil_DCacheInvalidateRange(devAddr, bytes);
+}
+
+/*
+ * Exact length read (IO_TRANS_READ_EXACT) of all results of a single segment
+ * request: resultEmbeddings * embeddingLength fp32 values rather than nlb
+ * padded sectors. Ready sectors from read->nextSector on are merged into one
+ * byte range and sent by direct DMA, cut only at host pages (which also keeps
+ * each DMA within the 4KB direct DMA limit). The command is completed with the
+ * last byte, or failed up front if the direct DMA can't reach its buffer.
+ * Returns 1 once done.
+ */
+int returnTranslatedResultsNonBlocking(struct transReqEntry* read)
+{
+	unsigned int entryIdx = read->entryIdx;
+	unsigned int sector, start, end, len, addrL, addrH;
+	unsigned int entry, entries, room, *list;
+
+	if (transMap->bufEntry[entryIdx].failed)
+		return FailExactTransRead(read);
+	if (!transMap->bufEntry[entryIdx].configured)
+		return 0;
+
+	struct transConfig* config = (struct transConfig*)transMap->bufEntry[entryIdx].configAddr;
+	unsigned int resultBytes = config->resultEmbeddings * config->embeddingLength * sizeof(float);
+	unsigned int hostPages = ((read->prp[0] & 0xfff) + resultBytes + 0xfff) / 0x1000;
+
+	// Direct DMAs move qwords, the spec lets PRP1 be only dword aligned
+	if ((read->prp[0] & 0x7) || (hostPages > 1 && (read->prp[2] & 0x7)))
+		return FailExactTransRead(read);
+
+	/*
+	 * Past two pages PRP2 points at a list, fetched once into the arena. When
+	 * the list runs past the end of a host page, the last entry of that page
+	 * points at the page holding the rest.
+	 */
+	if (hostPages > 2 && !read->prpList)
+	{
+		entries = hostPages - 1;
+		read->prpList = TransArenaAlloc(entryIdx, entries * 2 * sizeof(unsigned int), 0);
+		if (!read->prpList)
+			return 0;
+		list = (unsigned int*)read->prpList;
+
+		addrL = read->prp[2];
+		addrH = read->prp[3];
+		for (entry = 0; ; entry += room - 1)
+		{
+			room = (0x1000 - (addrL & 0xfff)) / (2 * sizeof(unsigned int));
+			if (entries - entry <= room)
+			{
+				FetchPrpEntries((unsigned int)&list[entry * 2], addrH, addrL, entries - entry);
+				break;
+			}
+
+			FetchPrpEntries((unsigned int)&list[entry * 2], addrH, addrL, room);
+			addrL = list[(entry + room - 1) * 2];
+			addrH = list[(entry + room - 1) * 2 + 1];
+			// Like any list entry past PRP1 it has no page offset
+			if (addrL & 0xfff)
+				return FailExactTransRead(read);
+		}
+	}
+
+	for (sector = read->nextSector; sector < transMap->bufEntry[entryIdx].nlb; sector++)
+	{
+		if (transMap->bufEntry[entryIdx].perResultSectorCompletedEmbeddings[sector] <
+				transMap->bufEntry[entryIdx].perResultSectorInputEmbeddings[sector])
+			break;
+		transMap->bufEntry[entryIdx].perResultSectorCompletedEmbeddings[sector] = 0;
+		FinalizeResultSector(entryIdx, sector);
+		transMap->bufEntry[entryIdx].sectorRequested[sector] = read->requested;
+		XTime_GetTime(&transMap->bufEntry[entryIdx].sectorRequestCompleted[sector]);
+	}
+	if (sector == read->nextSector)
+		return 0;
+
+	start = read->nextSector * SECTOR_SIZE_FTL;
+	end = sector * SECTOR_SIZE_FTL;
+	if (end > resultBytes)
+		end = resultBytes;
+	Xil_DCacheFlushRange((unsigned int)transMap->bufEntry[entryIdx].results + start, end - start);
+	for (; start < end; start += len)
+	{
+		len = 0x1000 - ((start + (read->prp[0] & 0xfff)) & 0xfff);
+		if (len > end - start)
+			len = end - start;
+		ExactReadHostAddr(read, start, &addrL, &addrH);
+		set_direct_tx_dma((unsigned int)transMap->bufEntry[entryIdx].results + start, addrH, addrL, len);
+	}
+
+	transMap->bufEntry[entryIdx].nlbCompleted += sector - read->nextSector;
+	read->nextSector = sector;
+	if (sector < transMap->bufEntry[entryIdx].nlb)
+		return 0;
+
+	// Direct DMAs aren't counted by auto completion, complete once the data is out
+	NVME_COMPLETION nvmeCPL;
+	check_direct_tx_dma_done();
+	nvmeCPL.dword[0] = 0;
+	nvmeCPL.specific = 0x0;
+	set_auto_nvme_cpl(read->cmdSlotTag, nvmeCPL.specific, nvmeCPL.statusFieldWord);
+
+	transMap->bufEntry[entryIdx].exactRead = 0;
+	CompleteTransSegment(entryIdx);
+	return 1;
+}
+
 int translatePagesNonBlocking(unsigned int entryIdx, unsigned int nextPageIdx)
 {
   unsigned page, lpa;
-  for (page = nextPageIdx;
-      page < transMap->bufEntry[entryIdx].nPages;
-      page++)
+  unsigned readyPages;
+
+  // A preload frees its own entry once its last row is in, or when it had none to read
+  if (!transMap->bufEntry[entryIdx].allocated)
+    return -1;
+
+  readyPages = transMap->bufEntry[entryIdx].nPages;
+
+  // While the config is still being walked the last listed page may grow
+  if (!transMap->bufEntry[entryIdx].configured && readyPages)
+    readyPages--;
+
+  for (page = nextPageIdx; page < readyPages; page++)
   {
     lpa = transMap->bufEntry[entryIdx].perPageSLBAs[page] / SECTOR_NUM_PER_PAGE;
     //xil_printf("Reading page %d -- lpa %d\r\n", page, lpa);
@@ -296,108 +1325,148 @@ int translatePagesNonBlocking(unsigned int entryIdx, unsigned int nextPageIdx)
     }
   }
 
+  if (!transMap->bufEntry[entryIdx].allocated)
+    return -1;
+  if (!transMap->bufEntry[entryIdx].configured)
+    return page;
+
   // We're all done
   return -1;
 }
 
 void translatePage(unsigned int entryIdx, void* devAddr, unsigned int pageIdx)
 {
+  if (transMap->bufEntry[entryIdx].preload)
+  {
+    translatePreloadPage(entryIdx, devAddr, pageIdx);
+    return;
+  }
+
   XTime_GetTime(&transMap->bufEntry[entryIdx].translationStarted[pageIdx]);
 
-  struct transConfig* config = (struct transConfig*)(TRANS_CONFIG_ADDR + entryIdx * TRANS_CONFIG_SIZE);
-  volatile struct attribute
-  {
-    char bytes[config->attributeSize];
-  } *fromPageBase,
-    *fromAtr,
-    *toBase,
-    *toAtr;
+  struct transConfig* config = (struct transConfig*)transMap->bufEntry[entryIdx].configAddr;
+  const struct transKernel* kernel = transMap->bufEntry[entryIdx].kernel;
+  unsigned int rowBytes = transMap->bufEntry[entryIdx].rowBytes;
+  unsigned int resultBytes = config->embeddingLength * sizeof(float);
+  unsigned char *fromPageBase, *fromAtr;
 
   /* Set local helpers from config. */
-  toBase = (struct attribute*)(TRANS_BUF_ADDR + entryIdx * TRANS_BUF_ENTRY_SIZE);
-  toAtr = toBase;
-  fromPageBase = (struct attribute*)devAddr;
-  fromAtr = fromPageBase;
-  unsigned pair_index = transMap->bufEntry[entryIdx].perPageStartingIndex[pageIdx];
-  unsigned n_embeddings = transMap->bufEntry[entryIdx].perPageInputLength[pageIdx];
-  unsigned base_embedding_id = ((transMap->bufEntry[entryIdx].perPageSLBAs[pageIdx] - transMap->bufEntry[entryIdx].slba) * SECTOR_SIZE_FTL) /
-  		  (config->attributeSize * config->embeddingLength);
-  unsigned embedding_offset, embedding_id, result_index, result_sector;
-
-  int i = 0;
-  for (i = 0; i < n_embeddings; i++)
+  fromPageBase = (unsigned char*)devAddr;
+  unsigned unique = transMap->bufEntry[entryIdx].perPageUniqueStart[pageIdx];
+  unsigned last_unique = transMap->bufEntry[entryIdx].perPageUniqueStart[pageIdx + 1];
+  unsigned base_embedding_id = ((transMap->bufEntry[entryIdx].perPageSLBAs[pageIdx] - transMap->bufEntry[entryIdx].slba) / SECTOR_NUM_PER_PAGE) *
+		  transMap->bufEntry[entryIdx].rowsPerPage;
+  unsigned embedding_offset, embedding_id, pair_index, last_pair;
+
+  for (; unique < last_unique; unique++)
   {
+	  pair_index = transMap->bufEntry[entryIdx].uniquePairStart[unique];
+	  last_pair = NextUniquePair(config, pair_index);
 	  embedding_id = config->embeddingIDList[pair_index].embeddingID;
-	  result_index = config->embeddingIDList[pair_index].result;
 	  embedding_offset = embedding_id - base_embedding_id;
-	  fromAtr = fromPageBase + (embedding_offset * config->embeddingLength);
-
-	  // Save to Cache - Direct map, overwrites previous entry
-	  unsigned int fullindex = (embedding_id << 5) | config->tableID;
-	  unsigned int cache_index = fullindex & ((0x1 << 20)-1);
-	  unsigned int tag = (fullindex >> 20) & ((0x1 << 12)-1);
-	  toAtr = (struct attribute*)transCache->cacheEntry[cache_index].embedding_bytes;
-	  int k = 0;
-	  for (k = 0; k < config->embeddingLength; k++)
+	  fromAtr = fromPageBase + (embedding_offset * rowBytes);
+
+	  // Save to Cache
+	  if (transMap->bufEntry[entryIdx].cacheable)
 	  {
-	  	*toAtr = *fromAtr;
-	  	toAtr++;
-	  	fromAtr++;
+		  unsigned int cache_line = TransCacheInsert(config->tableID, embedding_id, rowBytes, 0);
+		  if (cache_line != TRANS_EMBED_CACHE_MISS)
+			  kernel->copy(TRANS_CACHE_ROW(cache_line), fromAtr, config->embeddingLength);
 	  }
-	  transCache->cacheEntry[cache_index].valid = 1;
-	  transCache->cacheEntry[cache_index].tag = tag;
 	  // End Cache Save
 
-	  fromAtr = fromPageBase + (embedding_offset * config->embeddingLength);
-	  result_sector = (result_index * (config->embeddingLength * config->attributeSize)) / SECTOR_SIZE_FTL;
-	  toAtr = toBase + (result_index * config->embeddingLength);
-
-	  /* Perform reduction. SUM */
-	  for (k = 0; k < config->embeddingLength; k++)
-	  {
-		  // Assume for now attribute size is 4 and embedding entries are floats
-		  *((float*)toAtr) += *((float*)fromAtr);
-		  toAtr++;
-		  fromAtr++;
-	  }
+	  /* Perform reduction into every result which uses the row. */
+	  ScatterRow(entryIdx, config, fromAtr, pair_index, last_pair);
 
-	  transMap->bufEntry[entryIdx].perResultSectorCompletedEmbeddings[result_sector]++;
-	  pair_index++;
+	  for (; pair_index < last_pair; pair_index++)
+		  transMap->bufEntry[entryIdx].perResultSectorCompletedEmbeddings[
+				  (config->embeddingIDList[pair_index].result * resultBytes) / SECTOR_SIZE_FTL]++;
   }
 
   transMap->bufEntry[entryIdx].pagesTranslated++;
 
   XTime_GetTime(&transMap->bufEntry[entryIdx].translationCompleted[pageIdx]);
+
+  if (transMap->bufEntry[transMap->bufEntry[entryIdx].chainHead].failed)
+    ReapFailedTransRequest(transMap->bufEntry[entryIdx].chainHead);
+}
+
+static int FindTransMshr(unsigned int dieNo, unsigned int lpn)
+{
+  int mshr;
+
+  for (mshr = 0; mshr < TRANS_MSHR_NUM_PER_DIE; mshr++)
+    if (transMshr->mshr[dieNo][mshr].valid && transMshr->mshr[dieNo][mshr].lpn == lpn)
+      return mshr;
+
+  return -1;
+}
+
+/*
+ * Translate a page whose flash read has landed, for the request which issued
+ * the read and then for every request which attached to it meanwhile.
+ */
+void CompleteTransPageRead(unsigned int entryIdx, void* devAddr, unsigned int pageIdx, unsigned int dieNo, unsigned int mshr)
+{
+  unsigned int waiter;
+
+  translatePage(entryIdx, devAddr, pageIdx);
+  if (!transMshr->mshr[dieNo][mshr].valid)
+    return;
+
+  while ((waiter = transMshr->mshr[dieNo][mshr].waiterHead) != TRANS_MSHR_NONE)
+  {
+    transMshr->mshr[dieNo][mshr].waiterHead = transMshr->waiter[waiter].next;
+    translatePage(transMshr->waiter[waiter].entryIdx, devAddr, transMshr->waiter[waiter].pageIdx);
+
+    transMshr->waiter[waiter].next = transMshr->freeWaiter;
+    transMshr->freeWaiter = waiter;
+  }
+  transMshr->mshr[dieNo][mshr].valid = 0;
 }
 
 unsigned int readPageToTranslateNonBlocking(unsigned int entryIdx, unsigned int lpa, unsigned int page_idx)
 {
   XTime_GetTime(&transMap->bufEntry[entryIdx].flashReadStarted[page_idx]);
 
+  /*
+   * The page is already being read for another translation, its LRU buffer
+   * entry isn't filled yet. Wait for that read instead of issuing another.
+   */
+  unsigned int dieNo = lpa % DIE_NUM;
+  int mshr = FindTransMshr(dieNo, lpa);
+  if (mshr >= 0)
+  {
+    unsigned int waiter = transMshr->freeWaiter;
+    if (waiter == TRANS_MSHR_NONE) return 0;
+
+    transMshr->freeWaiter = transMshr->waiter[waiter].next;
+    transMshr->waiter[waiter].entryIdx = entryIdx;
+    transMshr->waiter[waiter].pageIdx = page_idx;
+    transMshr->waiter[waiter].next = transMshr->mshr[dieNo][mshr].waiterHead;
+    transMshr->mshr[dieNo][mshr].waiterHead = waiter;
+    transStats->merged_page_reads++;
+    return 1;
+  }
+
   unsigned int hitEntry = CheckBufHit(lpa);
   if (hitEntry != 0x7fff)
   {
     translatePage(entryIdx, (void*)(BUFFER_ADDR + hitEntry * BUF_ENTRY_SIZE),
               page_idx);
-
-    /* If we have two translation request which use the same page, one could
-     * submit a read request and the other could read from the allocated LRU
-     * buffer entry while the read request is still pending.
-     *
-     * We should really enqueue this in
-     * the normal scheduling framework so this doesn't happen.
-     *
-     * TODO This is important and will need to be done :).
-     */
   }
   else
   {
-    unsigned int dieNo = lpa % DIE_NUM;
     unsigned int dieLpn = lpa / DIE_NUM;
 
     /* If we don't have room to push this, don't mess up the LRU buffer. */
     if (!CheckReqQueueAvailability(dieNo % CHANNEL_NUM, dieNo / CHANNEL_NUM, 2)) return 0;
 
+    for (mshr = 0; mshr < TRANS_MSHR_NUM_PER_DIE; mshr++)
+      if (!transMshr->mshr[dieNo][mshr].valid)
+        break;
+    if (mshr == TRANS_MSHR_NUM_PER_DIE) return 0;
+
     unsigned int bufferEntry = AllocateBufEntry(lpa);
     ASSERT(bufferEntry < BUF_ENTRY_NUM);
 
@@ -432,9 +1501,14 @@ unsigned int readPageToTranslateNonBlocking(unsigned int entryIdx, unsigned int
 		lowLevelCmd.translate = 1;
 		lowLevelCmd.transBufferEntry = entryIdx;
 		lowLevelCmd.transPageIdx = page_idx;
+		lowLevelCmd.transMshr = mshr;
 		lowLevelCmd.request = V2FCommand_ReadPageTrigger;
 
 		ASSERT(PushToReqQueueNonBlocking(&lowLevelCmd, 0));
+
+		transMshr->mshr[dieNo][mshr].lpn = lpa;
+		transMshr->mshr[dieNo][mshr].waiterHead = TRANS_MSHR_NONE;
+		transMshr->mshr[dieNo][mshr].valid = 1;
 		return 1;
     }
     else
@@ -447,19 +1521,18 @@ unsigned int readPageToTranslateNonBlocking(unsigned int entryIdx, unsigned int
   return 1;
 }
 
-int findTransBufEntry(unsigned int requestId)
+// Entry of an in-flight request, -1 if there is none
+int findTransBufEntry(unsigned int requestId, unsigned int sqId)
 {
-	int foundIdx = -1;
-	int entryIdx;
-	for (entryIdx = 0; entryIdx < TRANS_BUF_ENTRY_NUM; entryIdx++)
+	unsigned int entryIdx = transTags->bucket[TransTagBucket(requestId, sqId)];
+
+	while (entryIdx != TRANS_TAG_NONE)
 	{
-		if (transMap->bufEntry[entryIdx].allocated &&
-			transMap->bufEntry[entryIdx].requestId == requestId)
-		{
-			foundIdx = entryIdx;
-			break;
-		}
+		if (transMap->bufEntry[entryIdx].requestId == requestId &&
+			transMap->bufEntry[entryIdx].sqId == sqId)
+			return entryIdx;
+		entryIdx = transMap->bufEntry[entryIdx].tagNext;
 	}
-	ASSERT(foundIdx != -1);
-	return foundIdx;
+
+	return -1;
 }
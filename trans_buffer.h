@@ -7,22 +7,40 @@
 
 #include "init_ftl.h"
 #include "internal_req.h"
+#include "lru_buffer.h" // BUF_ENTRY_NUM_PER_DIE
+#include "trans_arena.h"
+#include "trans_registry.h"
+#include "trans_kernel.h"
+#include "trans_cache.h"
 #include "xtime_l.h" // XTime_GetTime()
 
 // Macros for timing statistics
 #define TIMEDIFF(t1,t2) (t2 - t1)
 #define MICROSECONDS(t) (1000000.0 * t / COUNTS_PER_SECOND)
 
-#define TRANS_BUF_ENTRY_NUM 8
+/*
+ * Trans buffer entries only hold fixed size state, everything sized by the
+ * request (config, results, per-page and per-sector bookkeeping) lives in the
+ * arena (trans_arena.h) and is released at DeallocateTransBufEntry.
+ */
+#define TRANS_BUF_ENTRY_NUM 64
+#define TRANS_CHAIN_NONE 0xffff
 
+/*
+ * Result sectors are auto DMA'd to the host after the entry hands them out, so
+ * a finished request may still be read from. Each slot has a second (drain)
+ * arena owner: the finished request's allocations move there until its last
+ * TX DMA is done, while the slot itself takes the next request right away.
+ */
+#define TRANS_ARENA_DRAIN_OWNER(entryIdx) ((entryIdx) + TRANS_BUF_ENTRY_NUM)
+
+// Largest config and result scratchpad of a request segment
 #define TRANS_CONFIG_SIZE SECTOR_SIZE_FTL * 256
+#define TRANS_CONFIG_HEADER_SIZE 32
 #define TRANS_SCRATCHPAD_SIZE (SECTOR_SIZE_FTL * 256)
-#define TRANS_BUF_ENTRY_SIZE TRANS_SCRATCHPAD_SIZE
 
-#define MAX_EMBEDDINGS_PER_REQUEST 262144
-#define MAX_EMBEDDING_RESULT_PAGES 256
+#define MAX_EMBEDDING_RESULT_PAGES (TRANS_SCRATCHPAD_SIZE / SECTOR_SIZE_FTL)
 
-#define TRANS_EMBED_CACHE_ENTRY_NUM 1048576 // 2^20
 
 struct transBufEntry {
 	/*
@@ -42,36 +60,94 @@ struct transBufEntry {
 	unsigned int pagesTranslated;
 	*/
 
+	/* Arena allocations, see AllocateTransMetadata */
+	unsigned int configAddr; // struct transConfig or struct transPreloadConfig
+	unsigned int configBytes; // as DMAed from the host
+	float* results; // nlb sectors
+
 	/*
 	 * Some request configuration information needs to be reformatted/book-kept to
 	 * be partitioned by flash pages.
 	 *
 	 * This just makes the translation function simpler.
+	 *
+	 * Repeated IDs are coalesced: each distinct row which missed the cache is
+	 * one entry of the unique table, pointing at its first pair in
+	 * embeddingIDList. Its other pairs follow it (IDs are sorted), so the pair
+	 * list doubles as the scatter list of results which use the row. Page p
+	 * holds uniques [perPageUniqueStart[p], perPageUniqueStart[p + 1]).
 	 */
-	unsigned int perPageSLBAs[MAX_EMBEDDINGS_PER_REQUEST];
-	unsigned int perPageStartingIndex[MAX_EMBEDDINGS_PER_REQUEST];
-	unsigned int perPageInputLength[MAX_EMBEDDINGS_PER_REQUEST];
-	unsigned int perResultSectorInputEmbeddings[MAX_EMBEDDING_RESULT_PAGES];
-	unsigned int perResultSectorCompletedEmbeddings[MAX_EMBEDDING_RESULT_PAGES];
+	unsigned int* perPageSLBAs;
+	unsigned int* perPageUniqueStart;
+	unsigned int* uniquePairStart;
+	unsigned int* perResultSectorInputEmbeddings;
+	unsigned int* perResultSectorCompletedEmbeddings;
+	// Only kept for pooling operators which are finalized per result (MEAN, MAX)
+	unsigned int* perResultInputCount;
 	/* end reformatted config */
 
 	/* begin dynamic bookkeeping */
 	unsigned int  slba;
+	unsigned int  tableHandle;
+	struct transTableInfo table; // registry entry as of admission
 	unsigned int  requestId;
+	unsigned int  fusedSectors; // result sectors of a fused command, 0 otherwise
 	unsigned int  nlb;
 	unsigned int  nlbRequested;
 	unsigned int  nlbCompleted;
 	unsigned int  nPages;
 	unsigned int  pagesTranslated;
+	unsigned int  configCursor; // next ID pair to walk, see TRANS_CONFIG_SLICE
+	unsigned int  configUniques; // distinct IDs walked so far
+
+	// Pooling kernel for this request's (attribute type, embedding length)
+	const struct transKernel* kernel;
+	// Quantized tables only: decodes a stored row to fp32, and pools decoded rows
+	const struct transKernel* decodeKernel;
+	const struct transKernel* decodedKernel;
+	// Stored row geometry of the table, see TransRowBytes
+	unsigned int rowBytes;
+	unsigned int rowsPerPage;
 
 	unsigned int  configured : 1;
 	unsigned int  allocated : 1;
 	unsigned int  rxDmaExe : 1;
 	unsigned int  rxDmaTail : 8;
-	unsigned int  reserved1 : 21;
+	unsigned int  preload : 1; // holds a struct transPreloadConfig, returns no results
+	unsigned int  preprocessed : 1; // ID list already transformed and sorted
+	unsigned int  sqId : 4; // submission queue of the request, scopes requestId
+	unsigned int  cacheable : 1; // rows go through the embedding cache
+	unsigned int  configFormat : 1; // TRANS_CONFIG_FORMAT_*, PAIRS once decoded
+	unsigned int  configStarted : 1; // setup done, ID list being walked
+	unsigned int  chainOpen : 1; // anchor only: more segments will follow
+	unsigned int  failed : 1; // anchor only: a config was rejected, see FailTransSegment
+	unsigned int  retired : 1; // arena space given back, see RetireTransSegment
+	unsigned int  exactRead : 1; // anchor only: an exact length read is queued
+	unsigned int  reserved1 : 8;
 	unsigned int  rxDmaOverFlowCnt;
+	unsigned int  txDmaExe : 1; // result sectors were auto DMA'd, the last at txDmaTail
+	unsigned int  txDmaTail : 8;
+	unsigned int  draining : 1; // the slot's previous scratchpad is still being sent
+	unsigned int  drainTail : 8;
+	unsigned int  drainQueued : 1; // a second scratchpad waits for the drain, the slot with it
+	unsigned int  reserved2 : 13;
+	unsigned int  txDmaOverFlowCnt;
+	unsigned int  drainOverFlowCnt;
 	unsigned int  prev : 16;
 	unsigned int  next : 16;
+	unsigned short tagNext; // next entry in the request tag bucket
+
+	/*
+	 * Segments of a chained request, see IO_TRANS_CHAIN_MORE. The first
+	 * segment is the anchor: it holds the tag and the chain until the last
+	 * segment is done, its nlbRequested counts result sectors of the whole
+	 * request. Segments whose sectors are all sent leave from the front.
+	 */
+	unsigned short chainHead; // anchor of the request, itself for the first segment
+	unsigned short chainNext;
+	unsigned short chainFront; // anchor only: oldest segment still in the chain
+	unsigned short chainTail; // anchor only: newest segment, valid while chainFront is
+	unsigned int  chainSkipped; // anchor only: result sectors of segments which left
 
 	// Timing counters TODO: do we need to change/remove these for recsys?
 
@@ -83,16 +159,15 @@ struct transBufEntry {
 
 	// Need a counter per page because these
 	// operations are asynchronous
-	// TODO -- too much memory :(
 
 	// Per Flash Page
-	XTime flashReadStarted[SECTOR_SIZE_FTL];
-	XTime translationStarted[SECTOR_SIZE_FTL];
-	XTime translationCompleted[SECTOR_SIZE_FTL];
+	XTime* flashReadStarted;
+	XTime* translationStarted;
+	XTime* translationCompleted;
 
 	// Per Returned Sector
-	XTime sectorRequested[SECTOR_SIZE_FTL];
-	XTime sectorRequestCompleted[SECTOR_SIZE_FTL];
+	XTime* sectorRequested;
+	XTime* sectorRequestCompleted;
 };
 
 struct transBufArray {
@@ -104,15 +179,57 @@ struct transBufAvailQueue {
   unsigned int tail : 16;
 };
 
-struct transEmbedCacheEntry {
-	unsigned char valid : 1;
-	unsigned int tag : 12;
-	unsigned int reserved0 : 19;
-	unsigned char embedding_bytes[128]; // Assuming fixed attribute size and embedding vector length
+/*
+ * In-flight requests by (sqId, requestId), chained through
+ * transBufEntry.tagNext. Preloads aren't named and aren't listed.
+ */
+#define TRANS_TAG_HASH_BITS 10
+#define TRANS_TAG_HASH_NUM (1 << TRANS_TAG_HASH_BITS)
+#define TRANS_TAG_NONE 0xffff
+
+struct transTagTable {
+  unsigned short bucket[TRANS_TAG_HASH_NUM];
 };
 
-struct transEmbedCache {
-	struct transEmbedCacheEntry cacheEntry[TRANS_EMBED_CACHE_ENTRY_NUM];
+/*
+ * Translation commands which find no free trans buffer entry or no arena room
+ * for their config wait here in arrival order, holding their NVMe command
+ * slot, and are started from the main loop once an entry is deallocated.
+ * Result reads of a waiting config wait behind it. The queue holds every
+ * command slot, so it never overflows.
+ *
+ * With TRANS_ADMIT_RETRY_DEPTH set, configs arriving while that many commands
+ * wait are completed with Namespace Not Ready instead, the suggested retry
+ * delay (us) is returned in DW0.
+ */
+#define TRANS_ADMIT_QUEUE_DEPTH 128 // cmdSlotTag is 7 bits
+#define TRANS_ADMIT_RETRY_DEPTH 0 // 0 queues every command
+#define TRANS_ADMIT_RETRY_DELAY_US 100 // until request latencies are known
+
+#define TRANS_ADMIT_CONFIG 0
+#define TRANS_ADMIT_PRELOAD 1
+#define TRANS_ADMIT_READ 2
+#define TRANS_ADMIT_CONFIG_CSR 3
+
+struct transAdmitEntry {
+  XTime requested;
+  unsigned int tableHandle;
+  unsigned int requestId;
+  unsigned int sectors;
+  unsigned short cmdSlotTag;
+  unsigned char sqId;
+  unsigned char type;
+  unsigned char chain; // IO_TRANS_CHAIN_MORE was set
+  unsigned short resultSectors; // fused command: results follow the config in its buffer
+  unsigned char exact; // read with IO_TRANS_READ_EXACT, sent to prp
+  unsigned int prp[4];
+};
+
+struct transAdmitQueue {
+  struct transAdmitEntry entry[TRANS_ADMIT_QUEUE_DEPTH];
+  unsigned int head;
+  unsigned int count;
+  unsigned int entryFreed; // an entry was deallocated since the last admission attempt
 };
 
 struct transConfig {
@@ -124,7 +241,7 @@ struct transConfig {
    * and MAC them together into a resulting embedding vector. We also
    * want to batch this operation.
    *
-   * Ex. IDs = [0, 15, 24, 32] -- sorted list of embedding IDs (row ID)
+   * Ex. IDs = [0, 15, 24, 32] -- list of embedding IDs (row ID), any order
    *     lengths = [3, 1] -- reduction count for each result embedding
    *
    *     resultEmbeddings = 2
@@ -132,17 +249,108 @@ struct transConfig {
    *     embeddingIDList = [0,0, 0,15, 0,24, 1,32, NULL]
    *
    *     result = ['embeddings 0, 15, 24 MACed', 'embedding 32']
+   *
+   * poolOperator selects the reduction (TRANS_POOL_*): SUM, MEAN, MAX or
+   * WEIGHTED_SUM. For WEIGHTED_SUM the ID list is followed by one float
+   * weight per pair, see TRANS_CONFIG_WEIGHTS. Empty bags return zeros.
+   *
+   * idTransform (TRANS_ID_*) maps raw feature IDs into a table of tableRows
+   * rows on the device, by modulo or by hash then modulo. The device sorts
+   * the (transformed) IDs itself, see PreprocessEmbeddingIDs.
+   *
+   * attributeSize, embeddingLength, tableID, idTransform and tableRows are
+   * filled in by the device from the table registry (the handle is in DW14 of
+   * the command), the host leaves them 0.
+   *
+   * TRANS_CONFIG_FORMAT_CSR configs replace the pair list with
+   *   unsigned int offsets[resultEmbeddings]; // first ID of each bag, offsets[0] = 0
+   *   IDs, per bag as zigzag deltas from the bag's previous ID (0 for its first),
+   *   each a LEB128 varint (7 bits per byte, low first, bit 7 set if more follow)
+   *   float weights[inputEmbeddings]; // WEIGHTED_SUM only, 4B aligned
+   * like EmbeddingBag offsets. Sorted bags take about 1 to 2 bytes per ID
+   * instead of 8. The device expands them into the pair format before use.
    */
   unsigned int attributeSize;
   unsigned int embeddingLength;
   unsigned int resultEmbeddings;
   unsigned int inputEmbeddings;
   unsigned int tableID;
+  unsigned int poolOperator;
+  unsigned int idTransform;
+  unsigned int tableRows;
   struct embeddingIDPair {
 	  unsigned int result;
 	  unsigned int embeddingID;
   };
-  struct embeddingIDPair embeddingIDList[(TRANS_CONFIG_SIZE - 20) / 8];
+  struct embeddingIDPair embeddingIDList[(TRANS_CONFIG_SIZE - TRANS_CONFIG_HEADER_SIZE) / 8];
+};
+
+#define TRANS_CONFIG_FORMAT_PAIRS 0
+#define TRANS_CONFIG_FORMAT_CSR 1
+#define TRANS_CONFIG_FORMAT_NUM 2
+
+// Largest ID list after decoding, bounded by the sort buffer (pair and weight per ID)
+#define TRANS_SORT_BUF_SIZE (6 * 1024 * 1024)
+#define TRANS_MAX_INPUT_EMBEDDINGS (TRANS_SORT_BUF_SIZE / (sizeof(struct embeddingIDPair) + sizeof(float)))
+
+// One quantized row decoded to fp32 (see ScatterRow), longer rows aren't decoded
+#define TRANS_DECODED_ROW_SIZE (TRANS_EMBED_CACHE_MAX_ROW_BYTES * sizeof(float))
+
+/*
+ * Distinct IDs walked per call to ConfigureTransBufEntry. Pages are read as
+ * soon as they are listed, so long configs overlap their walk with flash reads.
+ */
+#define TRANS_CONFIG_SLICE 1024
+
+#define TRANS_ID_RAW 0
+#define TRANS_ID_MODULO 1
+#define TRANS_ID_HASH 2
+#define TRANS_ID_TRANSFORM_NUM 3
+
+// LSD radix sort of the ID list, one pass per 8 bits of the largest ID
+#define TRANS_SORT_RADIX_BITS 8
+#define TRANS_SORT_RADIX (1 << TRANS_SORT_RADIX_BITS)
+
+#define TRANS_CONFIG_WEIGHTS(config) ((float*)&(config)->embeddingIDList[(config)->inputEmbeddings])
+
+#define TRANS_PRELOAD_TABLE_NUM 32
+#define TRANS_PRELOAD_HEADER_SIZE (12 + TRANS_PRELOAD_TABLE_NUM * 16)
+#define TRANS_PRELOAD_UNPIN_ALL 0x1
+#define TRANS_PRELOAD_WARM 0x2 // insert unpinned under admission, see trans_warm.h
+#define TRANS_PRELOAD_REQUEST_ID 0xffffffff // never matches a translation read
+#define TRANS_FUSED_REQUEST_ID 0xfffffffe // results return with the config command
+// Requests the host can't name are kept out of the tag table
+#define TransRequestTagged(id) ((id) < TRANS_FUSED_REQUEST_ID)
+
+struct transPreloadConfig {
+  /*
+   * Payload of IO_NVM_EMBED_PRELOAD, written to the config area of a trans
+   * buffer entry like a transConfig.
+   *
+   * Every listed row is read from flash and pinned in the embedding cache, so
+   * it is never replaced until the next TRANS_PRELOAD_UNPIN_ALL. Rows of the
+   * same table share pages, so the list is sorted by (table, rowID) like
+   * embeddingIDList, and a command may touch at most SECTOR_SIZE_FTL pages.
+   *
+   * table[] gives the flash location (starting LBA) and row format of each
+   * tableID used in rowList, tableIDs it doesn't list are looked up in the
+   * table registry. flags TRANS_PRELOAD_UNPIN_ALL drops the old pins
+   * first, an empty list with it only unpins. TRANS_PRELOAD_WARM inserts the
+   * rows like misses of a translation instead of pinning them.
+   */
+  unsigned int flags;
+  unsigned int tableNum;
+  unsigned int rowNum;
+  struct transPreloadTable {
+	  unsigned int tableID;
+	  unsigned int slba;
+	  unsigned int attributeSize;
+	  unsigned int embeddingLength;
+  } table[TRANS_PRELOAD_TABLE_NUM];
+  struct transPreloadRow {
+	  unsigned int tableID;
+	  unsigned int rowID;
+  } rowList[(TRANS_CONFIG_SIZE - TRANS_PRELOAD_HEADER_SIZE) / 8];
 };
 
 struct transStatistics {
@@ -161,23 +369,73 @@ struct transStatistics {
 
 	double cache_hits;
 	double cache_misses;
+	double cache_evictions;
+	double cache_rejections;
+	double cache_bypasses;
+	double cache_l1_hits;
+	double cache_l1_promotions;
+	double cache_quota_rejects;
+
+	double merged_page_reads;
+
+	double admission_waits;
+	double admission_rejects;
+
+	double failed_requests;
+	double failed_preloads;
+	double skipped_preload_rows;
+};
+
+/*
+ * In-flight translation page reads (MSHRs), per die and keyed by LPN. A
+ * translation page read which finds its LPN in flight attaches as a waiter
+ * instead of reading it again, and is translated when the read lands (see
+ * CompleteTransPageRead). The read carries its MSHR in the low-level request,
+ * as block I/O may take its LRU buffer entry over before it lands. Half of a
+ * die's LRU buffer entries at most are in flight for translation.
+ */
+#define TRANS_MSHR_NUM_PER_DIE (BUF_ENTRY_NUM_PER_DIE / 2)
+#define TRANS_MSHR_WAITER_NUM 1024
+#define TRANS_MSHR_NONE 0xffff
+
+struct transMshrEntry {
+	unsigned int lpn;
+	unsigned short waiterHead;
+	unsigned short valid;
+};
+
+struct transMshrWaiter {
+	unsigned int pageIdx;
+	unsigned short entryIdx;
+	unsigned short next;
+};
+
+struct transMshrTable {
+	struct transMshrEntry mshr[DIE_NUM][TRANS_MSHR_NUM_PER_DIE];
+	struct transMshrWaiter waiter[TRANS_MSHR_WAITER_NUM];
+	unsigned short freeWaiter;
 };
 
 extern struct transBufArray* transMap;
 extern struct transBufAvailQueue* transAvailQ;
+extern struct transAdmitQueue* transAdmitQ;
+extern struct transTagTable* transTags;
 extern struct transStatistics* transStats;
-
-extern struct transEmbedCache* transCache;
+extern struct transMshrTable* transMshr;
 
 void TransBufInit();
-unsigned int AllocateTransBufEntry(unsigned int slba, unsigned int requestId);
+unsigned int AllocateTransBufEntry(unsigned int slba, unsigned int requestId, unsigned int sqId, unsigned int configBytes);
 void DeallocateTransBufEntry(unsigned int entryIdx);
-void ConfigureTransBufEntry(unsigned int entryIdx);
-unsigned int readTranslatedPagesNonBlocking(unsigned int entryIdx, unsigned int firstSector, unsigned int nextSector,
-		unsigned int requestedSectors, unsigned int cmdSlotTag);
+void ReapTransDrains();
+int ConfigureTransBufEntry(unsigned int entryIdx);
+int readTranslatedPagesNonBlocking(unsigned int entryIdx, unsigned int firstSector, unsigned int nextSector,
+		unsigned int requestedSectors, unsigned int cmdSlotTag, XTime requested);
+struct transReqEntry;
+int returnTranslatedResultsNonBlocking(struct transReqEntry* read);
 int translatePagesNonBlocking(unsigned int entryIdx, unsigned int nextPage);
 void translatePage(unsigned int entryIdx, void* devAddr, unsigned int page_idx);
+void CompleteTransPageRead(unsigned int entryIdx, void* devAddr, unsigned int pageIdx, unsigned int dieNo, unsigned int mshr);
 unsigned int readPageToTranslateNonBlocking(unsigned int entryIdx, unsigned int lpa, unsigned int page_idx);
-int findTransBufEntry(unsigned int requestId);
+int findTransBufEntry(unsigned int requestId, unsigned int sqId);
 
 #endif /* IA_TRANS_BUFFER_H_ */
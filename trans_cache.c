@@ -0,0 +1,895 @@
+// Harvard University, VLSI-Arch Lab
+// Set-associative embedding row cache
+
+#include	"xil_printf.h"
+#include	"string.h"
+#include	"nvme/debug.h"
+#include	"trans_cache.h"
+#include	"trans_buffer.h"
+#include	"memory_map.h"
+
+struct transEmbedCacheTagArray* transCacheTags;
+struct transEmbedCache* transCache;
+struct transEmbedL1* transCacheL1;
+
+static inline unsigned int TransCacheKey(unsigned int tableID, unsigned int rowID)
+{
+	// Fibonacci hashing, consecutive rows of a table spread over all sets
+	return (rowID * 0x9e3779b1) ^ (tableID * 0x85ebca6b);
+}
+
+static inline unsigned int TransCacheSet(unsigned int tableID, unsigned int rowID)
+{
+	return TransCacheKey(tableID, rowID) >> TRANS_EMBED_CACHE_KEY_LOW_BITS;
+}
+
+static inline unsigned int TransCacheKeyLow(unsigned int tableID, unsigned int rowID)
+{
+	return TransCacheKey(tableID, rowID) & ((1 << TRANS_EMBED_CACHE_KEY_LOW_BITS) - 1);
+}
+
+// Row held by a tag of set, 0x0e8b2f51 is the inverse of the multiplier mod 2^32
+static inline unsigned int TransCacheTagRow(unsigned int set, const struct transEmbedCacheTag* tag)
+{
+	unsigned int key = (set << TRANS_EMBED_CACHE_KEY_LOW_BITS) | tag->keyLow;
+
+	return (key ^ (tag->tableID * 0x85ebca6b)) * 0x0e8b2f51;
+}
+
+static inline unsigned int TransCacheGen(unsigned int tableID)
+{
+	return (transCacheTags->epoch + transCacheTags->tableEpoch[tableID]) & TRANS_EMBED_CACHE_GEN_MASK;
+}
+
+// Valid and filled under the current epochs
+static inline int TransCacheTagLive(const struct transEmbedCacheTag* tag)
+{
+	return tag->valid && tag->gen == TransCacheGen(tag->tableID);
+}
+
+static inline int TransCacheFindWay(unsigned int set, unsigned int tableID, unsigned int rowID)
+{
+	struct transEmbedCacheTag* tag = transCacheTags->tag[set];
+	unsigned int keyLow = TransCacheKeyLow(tableID, rowID);
+	int way;
+
+	for (way = 0; way < TRANS_EMBED_CACHE_WAYS; way++)
+		if (tag[way].valid && tag[way].keyLow == keyLow && tag[way].tableID == tableID &&
+				tag[way].gen == TransCacheGen(tableID))
+			return way;
+
+	return -1;
+}
+
+static const unsigned int transAdmitSeed[TRANS_ADMIT_SKETCH_DEPTH] = {0x9e3779b1, 0x85ebca77, 0xc2b2ae3d, 0x27d4eb2f};
+
+static inline unsigned int TransAdmitIndex(unsigned int tableID, unsigned int rowID, unsigned int depth)
+{
+	return ((rowID + tableID * 0x165667b1) * transAdmitSeed[depth]) >> (32 - TRANS_ADMIT_SKETCH_WIDTH_BITS);
+}
+
+// Estimated popularity of a row, the minimum over the sketch rows
+static unsigned int TransAdmitFrequency(unsigned int tableID, unsigned int rowID)
+{
+	unsigned int depth, count, freq = TRANS_ADMIT_COUNTER_MAX;
+
+	for (depth = 0; depth < TRANS_ADMIT_SKETCH_DEPTH; depth++)
+	{
+		count = transCacheTags->sketch.counter[depth][TransAdmitIndex(tableID, rowID, depth)];
+		if (count < freq)
+			freq = count;
+	}
+	return freq;
+}
+
+static void TransAdmitRecord(unsigned int tableID, unsigned int rowID)
+{
+	struct transAdmitSketch* sketch = &transCacheTags->sketch;
+	unsigned int depth, i;
+	unsigned char* counter;
+
+	for (depth = 0; depth < TRANS_ADMIT_SKETCH_DEPTH; depth++)
+	{
+		counter = &sketch->counter[depth][TransAdmitIndex(tableID, rowID, depth)];
+		if (*counter < TRANS_ADMIT_COUNTER_MAX)
+			(*counter)++;
+	}
+
+	// Aging
+	if (++sketch->samples == TRANS_ADMIT_SAMPLE_SIZE)
+	{
+		for (depth = 0; depth < TRANS_ADMIT_SKETCH_DEPTH; depth++)
+			for (i = 0; i < TRANS_ADMIT_SKETCH_WIDTH; i++)
+				sketch->counter[depth][i] >>= 1;
+		sketch->samples /= 2;
+	}
+}
+
+static void TransCacheRecordLookup(unsigned int tableID, unsigned int hit)
+{
+	struct transCacheTableStats* table = &transCacheTags->table[tableID];
+
+	table->totalLookups++;
+	table->totalHits += hit;
+	table->hits += hit;
+	if (++table->lookups < TRANS_BYPASS_WINDOW)
+		return;
+
+	if (table->bypassWindows)
+		table->bypassWindows--;
+	else if (table->hits * 100 < table->lookups * TRANS_BYPASS_HIT_PERCENT)
+		table->bypassWindows = TRANS_BYPASS_WINDOWS;
+
+	table->lookups = 0;
+	table->hits = 0;
+}
+
+// Smallest size class holding rowBytes, TRANS_EMBED_CACHE_CLASS_NUM if the row is too wide
+static inline unsigned int TransCacheClass(unsigned int rowBytes)
+{
+	unsigned int sizeClass = 0;
+
+	while (sizeClass < TRANS_EMBED_CACHE_CLASS_NUM && (TRANS_EMBED_CACHE_UNIT_SIZE << sizeClass) < rowBytes)
+		sizeClass++;
+
+	return sizeClass;
+}
+
+static inline unsigned int TransCacheUnitClass(unsigned int unit)
+{
+	return transCacheTags->slabClass[unit / TRANS_EMBED_CACHE_UNITS_PER_SLAB];
+}
+
+// Drop the row held in unit, the tag is left to the caller
+static void TransCacheReleaseUnit(unsigned int unit)
+{
+	transCacheTags->owner[unit] = TRANS_EMBED_CACHE_NO_OWNER;
+	transCacheTags->sizeClass[TransCacheUnitClass(unit)].rows--;
+}
+
+static void TransCacheUnpinTag(struct transEmbedCacheTag* tag)
+{
+	unsigned int rowBytes = TRANS_EMBED_CACHE_UNIT_SIZE << TransCacheUnitClass(tag->unit);
+
+	tag->pinned = 0;
+	transCacheTags->slabPins[tag->unit / TRANS_EMBED_CACHE_UNITS_PER_SLAB]--;
+	// Stale pins left the budget when their table's epoch was bumped
+	if (!TransCacheTagLive(tag))
+		return;
+	transCacheTags->table[tag->tableID].pinnedRows--;
+	transCacheTags->table[tag->tableID].pinnedBytes -= rowBytes;
+	transCacheTags->pinnedRows--;
+	transCacheTags->pinnedBytes -= rowBytes;
+}
+
+// Unpin the stale rows of a slab, true if none of its rows is pinned anymore
+static int TransCacheUnpinStale(unsigned int slab)
+{
+	unsigned int unit = slab * TRANS_EMBED_CACHE_UNITS_PER_SLAB;
+	unsigned int lastUnit = unit + TRANS_EMBED_CACHE_UNITS_PER_SLAB;
+	struct transEmbedCacheTag* tag;
+
+	for (; unit < lastUnit && transCacheTags->slabPins[slab]; unit++)
+	{
+		if (transCacheTags->owner[unit] == TRANS_EMBED_CACHE_NO_OWNER)
+			continue;
+		tag = &transCacheTags->tag[transCacheTags->owner[unit] / TRANS_EMBED_CACHE_WAYS]
+				[transCacheTags->owner[unit] % TRANS_EMBED_CACHE_WAYS];
+		if (tag->pinned && !TransCacheTagLive(tag))
+			TransCacheUnpinTag(tag);
+	}
+
+	return !transCacheTags->slabPins[slab];
+}
+
+// Invalidate a cached row and free its slot
+static void TransCacheDropTag(struct transEmbedCacheTag* tag)
+{
+	if (tag->pinned)
+		TransCacheUnpinTag(tag);
+	// Stale rows were taken off their table's occupancy when its epoch was bumped
+	if (TransCacheTagLive(tag))
+		transCacheTags->table[tag->tableID].units -= 1 << TransCacheUnitClass(tag->unit);
+	tag->valid = 0;
+	TransCacheReleaseUnit(tag->unit);
+}
+
+// Drop every row of a slab and hand the slab to sizeClass
+static void TransCacheMoveSlab(unsigned int slab, unsigned int sizeClass)
+{
+	unsigned int unit = slab * TRANS_EMBED_CACHE_UNITS_PER_SLAB;
+	unsigned int lastUnit = unit + TRANS_EMBED_CACHE_UNITS_PER_SLAB;
+	unsigned int owner;
+
+	if (transCacheTags->slabClass[slab] == TRANS_EMBED_CACHE_FREE_SLAB)
+		transCacheTags->freeSlabs--;
+	else
+	{
+		for (; unit < lastUnit; unit++)
+		{
+			owner = transCacheTags->owner[unit];
+			if (owner == TRANS_EMBED_CACHE_NO_OWNER)
+				continue;
+
+			TransCacheDropTag(&transCacheTags->tag[owner / TRANS_EMBED_CACHE_WAYS][owner % TRANS_EMBED_CACHE_WAYS]);
+			transStats->cache_evictions++;
+		}
+		transCacheTags->sizeClass[transCacheTags->slabClass[slab]].slabs--;
+	}
+
+	transCacheTags->slabClass[slab] = sizeClass;
+	transCacheTags->sizeClass[sizeClass].slabs++;
+	transCacheTags->sizeClass[sizeClass].clockUnit = slab * TRANS_EMBED_CACHE_UNITS_PER_SLAB;
+}
+
+/*
+ * Find a slab for a full size class: a free one, or one taken from the class
+ * holding the most slabs if this class is below its fair share.
+ */
+static unsigned int TransCacheGrowClass(unsigned int sizeClass)
+{
+	unsigned int slab, i, active, share, victim;
+
+	if (transCacheTags->freeSlabs)
+	{
+		for (slab = 0; slab < TRANS_EMBED_CACHE_SLAB_NUM; slab++)
+			if (transCacheTags->slabClass[slab] == TRANS_EMBED_CACHE_FREE_SLAB)
+				return slab;
+	}
+
+	active = 0;
+	victim = sizeClass;
+	for (i = 0; i < TRANS_EMBED_CACHE_CLASS_NUM; i++)
+	{
+		if (transCacheTags->sizeClass[i].slabs || i == sizeClass)
+			active++;
+		if (transCacheTags->sizeClass[i].slabs > transCacheTags->sizeClass[victim].slabs)
+			victim = i;
+	}
+
+	share = TRANS_EMBED_CACHE_SLAB_NUM / active;
+	if (transCacheTags->sizeClass[sizeClass].slabs >= share || transCacheTags->sizeClass[victim].slabs <= share)
+		return TRANS_EMBED_CACHE_SLAB_NUM;
+
+	// Take the slab the victim's hand is about to sweep, its rows are the coldest
+	slab = transCacheTags->sizeClass[victim].clockUnit / TRANS_EMBED_CACHE_UNITS_PER_SLAB;
+	for (i = 0; i < TRANS_EMBED_CACHE_SLAB_NUM; i++)
+	{
+		if (transCacheTags->slabClass[slab] == victim && TransCacheUnpinStale(slab))
+			break;
+		slab = (slab + 1) % TRANS_EMBED_CACHE_SLAB_NUM;
+	}
+	if (i == TRANS_EMBED_CACHE_SLAB_NUM)
+		return TRANS_EMBED_CACHE_SLAB_NUM;
+	transCacheTags->sizeClass[victim].clockUnit =
+			((slab + 1) % TRANS_EMBED_CACHE_SLAB_NUM) * TRANS_EMBED_CACHE_UNITS_PER_SLAB;
+
+	return slab;
+}
+
+// A live row another table may not replace, its table is within its reservation
+static inline int TransCacheReserved(const struct transEmbedCacheTag* tag, unsigned int tableID)
+{
+	return tag->tableID != tableID &&
+			transCacheTags->table[tag->tableID].units <= transCacheTags->table[tag->tableID].reserved;
+}
+
+/*
+ * Returns a free unit of sizeClass for a row of tableID, evicting a row less
+ * popular than freq if needed. Returns TRANS_EMBED_CACHE_MISS if the CLOCK
+ * victim wins admission, or if every row of the class is pinned or reserved.
+ */
+static unsigned int TransCacheAllocUnit(unsigned int sizeClass, unsigned int freq, unsigned int tableID)
+{
+	struct transEmbedCacheClass* cls = &transCacheTags->sizeClass[sizeClass];
+	unsigned int classUnits = 1 << sizeClass;
+	unsigned int slab, unit, owner, steps;
+	struct transEmbedCacheTag* tag;
+
+	if (cls->rows == cls->slabs * (TRANS_EMBED_CACHE_UNITS_PER_SLAB / classUnits))
+	{
+		slab = TransCacheGrowClass(sizeClass);
+		if (slab != TRANS_EMBED_CACHE_SLAB_NUM)
+			TransCacheMoveSlab(slab, sizeClass);
+	}
+
+	// Two sweeps clear every reference bit, anything longer means the class is pinned
+	for (steps = 0; ; steps++)
+	{
+		if (steps > 2 * (TRANS_EMBED_CACHE_UNIT_NUM / classUnits) + TRANS_EMBED_CACHE_SLAB_NUM)
+			return TRANS_EMBED_CACHE_MISS;
+
+		unit = cls->clockUnit;
+		slab = unit / TRANS_EMBED_CACHE_UNITS_PER_SLAB;
+		if (transCacheTags->slabClass[slab] != sizeClass)
+		{
+			cls->clockUnit = ((slab + 1) % TRANS_EMBED_CACHE_SLAB_NUM) * TRANS_EMBED_CACHE_UNITS_PER_SLAB;
+			continue;
+		}
+		cls->clockUnit = (unit + classUnits) % TRANS_EMBED_CACHE_UNIT_NUM;
+
+		owner = transCacheTags->owner[unit];
+		if (owner == TRANS_EMBED_CACHE_NO_OWNER)
+			break;
+
+		tag = &transCacheTags->tag[owner / TRANS_EMBED_CACHE_WAYS][owner % TRANS_EMBED_CACHE_WAYS];
+		if (!TransCacheTagLive(tag))
+		{
+			TransCacheDropTag(tag);
+			break;
+		}
+		if (tag->pinned || TransCacheReserved(tag, tableID))
+			continue;
+		if (!tag->ref)
+		{
+			if (TransAdmitFrequency(tag->tableID, TransCacheTagRow(owner / TRANS_EMBED_CACHE_WAYS, tag)) >= freq)
+			{
+				transStats->cache_rejections++;
+				return TRANS_EMBED_CACHE_MISS;
+			}
+			TransCacheDropTag(tag);
+			transStats->cache_evictions++;
+			break;
+		}
+		tag->ref = 0;
+	}
+
+	cls->rows++;
+	return unit;
+}
+
+static inline unsigned int TransCacheL1Units(unsigned int rowBytes)
+{
+	return (rowBytes + TRANS_EMBED_CACHE_UNIT_SIZE - 1) / TRANS_EMBED_CACHE_UNIT_SIZE;
+}
+
+static const unsigned char* TransCacheL1Lookup(unsigned int tableID, unsigned int rowID, unsigned int units)
+{
+	unsigned int set = TransCacheSet(tableID, rowID) & (TRANS_EMBED_L1_SET_NUM - 1);
+	struct transEmbedL1Tag* tag = transCacheL1->tag[set];
+	unsigned int way;
+
+	for (way = 0; way < TRANS_EMBED_L1_WAYS; way++)
+		if (tag[way].units == units && tag[way].rowID == rowID && tag[way].tableID == tableID)
+		{
+			transCacheL1->lru[set] = !way;
+			return transCacheL1->data[tag[way].unit];
+		}
+
+	return 0;
+}
+
+/*
+ * Copy a hot row from the DRAM cache to the head of the L1 log. Rows the head
+ * runs over are dropped, a row which doesn't fit before the end of the log
+ * starts over at unit 0.
+ */
+static void TransCacheL1Promote(unsigned int tableID, unsigned int rowID, const unsigned char* row, unsigned int units)
+{
+	unsigned int set = TransCacheSet(tableID, rowID) & (TRANS_EMBED_L1_SET_NUM - 1);
+	struct transEmbedL1Tag* tag = transCacheL1->tag[set];
+	unsigned int way, unit, owner;
+
+	// A key cached under another row size (the table was reconfigured) keeps its way
+	for (way = 0; way < TRANS_EMBED_L1_WAYS; way++)
+		if (tag[way].units && tag[way].rowID == rowID && tag[way].tableID == tableID)
+			break;
+	if (way == TRANS_EMBED_L1_WAYS)
+		for (way = 0; way < TRANS_EMBED_L1_WAYS; way++)
+			if (!tag[way].units)
+				break;
+	if (way == TRANS_EMBED_L1_WAYS)
+		way = transCacheL1->lru[set];
+	if (tag[way].units)
+	{
+		transCacheL1->owner[tag[way].unit] = TRANS_EMBED_L1_NO_OWNER;
+		tag[way].units = 0;
+	}
+
+	if (transCacheL1->head + units > TRANS_EMBED_L1_UNIT_NUM)
+		transCacheL1->head = 0;
+	for (unit = transCacheL1->head; unit < transCacheL1->head + units; unit++)
+	{
+		owner = transCacheL1->owner[unit];
+		if (owner == TRANS_EMBED_L1_NO_OWNER)
+			continue;
+		transCacheL1->tag[owner / TRANS_EMBED_L1_WAYS][owner % TRANS_EMBED_L1_WAYS].units = 0;
+		transCacheL1->owner[unit] = TRANS_EMBED_L1_NO_OWNER;
+	}
+
+	memcpy(transCacheL1->data[transCacheL1->head], row, units * TRANS_EMBED_CACHE_UNIT_SIZE);
+	tag[way].unit = transCacheL1->head;
+	tag[way].rowID = rowID;
+	tag[way].tableID = tableID;
+	tag[way].units = units;
+	transCacheL1->owner[transCacheL1->head] = set * TRANS_EMBED_L1_WAYS + way;
+	transCacheL1->lru[set] = !way;
+	transCacheL1->head += units;
+	transStats->cache_l1_promotions++;
+}
+
+void TransCacheInit()
+{
+	unsigned int set, way, unit, slab, sizeClass, i;
+
+	transCacheTags = (struct transEmbedCacheTagArray*)TRANS_EMBED_CACHE_TAG_ADDR;
+	transCache = (struct transEmbedCache*)TRANS_EMBED_CACHE_ADDR;
+	transCacheL1 = (struct transEmbedL1*)TRANS_EMBED_L1_ADDR;
+	ASSERT(sizeof(struct transEmbedL1) <= TRANS_EMBED_L1_SIZE);
+	ASSERT(sizeof(struct transEmbedCacheTag) == 8);
+
+	for (set = 0; set < TRANS_EMBED_CACHE_SET_NUM; set++)
+	{
+		for (way = 0; way < TRANS_EMBED_CACHE_WAYS; way++)
+		{
+			transCacheTags->tag[set][way].valid = 0;
+			transCacheTags->tag[set][way].ref = 0;
+			transCacheTags->tag[set][way].pinned = 0;
+		}
+		transCacheTags->clockHand[set] = 0;
+	}
+
+	for (unit = 0; unit < TRANS_EMBED_CACHE_UNIT_NUM; unit++)
+		transCacheTags->owner[unit] = TRANS_EMBED_CACHE_NO_OWNER;
+	for (slab = 0; slab < TRANS_EMBED_CACHE_SLAB_NUM; slab++)
+	{
+		transCacheTags->slabClass[slab] = TRANS_EMBED_CACHE_FREE_SLAB;
+		transCacheTags->slabPins[slab] = 0;
+	}
+	transCacheTags->freeSlabs = TRANS_EMBED_CACHE_SLAB_NUM;
+	transCacheTags->pinnedRows = 0;
+	transCacheTags->pinnedBytes = 0;
+	transCacheTags->reservedUnits = 0;
+
+	for (sizeClass = 0; sizeClass < TRANS_EMBED_CACHE_CLASS_NUM; sizeClass++)
+	{
+		transCacheTags->sizeClass[sizeClass].slabs = 0;
+		transCacheTags->sizeClass[sizeClass].rows = 0;
+		transCacheTags->sizeClass[sizeClass].clockUnit = 0;
+	}
+
+	for (i = 0; i < TRANS_ADMIT_SKETCH_DEPTH; i++)
+		for (unit = 0; unit < TRANS_ADMIT_SKETCH_WIDTH; unit++)
+			transCacheTags->sketch.counter[i][unit] = 0;
+	transCacheTags->sketch.samples = 0;
+
+	for (i = 0; i < TRANS_EMBED_CACHE_TABLE_NUM; i++)
+	{
+		transCacheTags->table[i].lookups = 0;
+		transCacheTags->table[i].hits = 0;
+		transCacheTags->table[i].bypassWindows = 0;
+		transCacheTags->table[i].units = 0;
+		transCacheTags->table[i].quota = TRANS_EMBED_CACHE_NO_QUOTA;
+		transCacheTags->table[i].reserved = 0;
+		transCacheTags->table[i].pinnedRows = 0;
+		transCacheTags->table[i].pinnedBytes = 0;
+		transCacheTags->table[i].totalLookups = 0;
+		transCacheTags->table[i].totalHits = 0;
+		transCacheTags->tableEpoch[i] = 0;
+	}
+	transCacheTags->epoch = 0;
+	transCacheTags->epochBumps = 0;
+
+	for (set = 0; set < TRANS_EMBED_L1_SET_NUM; set++)
+	{
+		for (way = 0; way < TRANS_EMBED_L1_WAYS; way++)
+			transCacheL1->tag[set][way].units = 0;
+		transCacheL1->lru[set] = 0;
+	}
+	for (unit = 0; unit < TRANS_EMBED_L1_UNIT_NUM; unit++)
+		transCacheL1->owner[unit] = TRANS_EMBED_L1_NO_OWNER;
+	transCacheL1->head = 0;
+}
+
+/*
+ * Returns the cached row (tableID, rowID), from the OCM tier if it is there,
+ * or 0. A row cached under a different size (the table was reconfigured)
+ * misses. Every lookup feeds the admission sketch and the table's hit rate,
+ * and DRAM hits on rows popular enough are promoted to the OCM tier.
+ */
+const unsigned char* TransCacheLookup(unsigned int tableID, unsigned int rowID, unsigned int rowBytes)
+{
+	unsigned int set = TransCacheSet(tableID, rowID);
+	unsigned int units = TransCacheL1Units(rowBytes);
+	const unsigned char* row;
+	int way;
+
+	if (tableID >= TRANS_EMBED_CACHE_TABLE_NUM)
+		return 0;
+
+	TransAdmitRecord(tableID, rowID);
+
+	row = TransCacheL1Lookup(tableID, rowID, units);
+	if (row)
+	{
+		TransCacheRecordLookup(tableID, 1);
+		transStats->cache_l1_hits++;
+		return row;
+	}
+
+	way = TransCacheFindWay(set, tableID, rowID);
+	if (way < 0 || TransCacheUnitClass(transCacheTags->tag[set][way].unit) != TransCacheClass(rowBytes))
+	{
+		TransCacheRecordLookup(tableID, 0);
+		return 0;
+	}
+
+	TransCacheRecordLookup(tableID, 1);
+	transCacheTags->tag[set][way].ref = 1;
+	row = TRANS_CACHE_ROW(transCacheTags->tag[set][way].unit);
+
+	if (rowBytes <= TRANS_EMBED_L1_MAX_ROW_BYTES &&
+			TransAdmitFrequency(tableID, rowID) >= TRANS_EMBED_L1_PROMOTE_FREQ)
+		TransCacheL1Promote(tableID, rowID, row, units);
+
+	return row;
+}
+
+// Pin a cached row if the pin budget and its set allow it
+static void TransCachePinTag(unsigned int set, struct transEmbedCacheTag* tag)
+{
+	unsigned int rowBytes = TRANS_EMBED_CACHE_UNIT_SIZE << TransCacheUnitClass(tag->unit);
+	unsigned int way, pinnedWays = 0;
+
+	if (tag->pinned || transCacheTags->pinnedBytes + rowBytes > TRANS_EMBED_CACHE_PIN_BYTES)
+		return;
+	for (way = 0; way < TRANS_EMBED_CACHE_WAYS; way++)
+		pinnedWays += TransCacheTagLive(&transCacheTags->tag[set][way]) && transCacheTags->tag[set][way].pinned;
+	if (pinnedWays + 1 >= TRANS_EMBED_CACHE_WAYS)
+		return;
+
+	tag->pinned = 1;
+	transCacheTags->slabPins[tag->unit / TRANS_EMBED_CACHE_UNITS_PER_SLAB]++;
+	transCacheTags->table[tag->tableID].pinnedRows++;
+	transCacheTags->table[tag->tableID].pinnedBytes += rowBytes;
+	transCacheTags->pinnedRows++;
+	transCacheTags->pinnedBytes += rowBytes;
+}
+
+/*
+ * Claims a cache line for (tableID, rowID) and returns it, the caller fills in
+ * the row. A row which is already cached keeps its line. Otherwise a free or
+ * stale way is used, or the CLOCK hand picks the first unpinned way not referenced since
+ * it last passed, and the row gets a slot of its size class.
+ *
+ * pin rows skip admission and the table bypass, and stay cached until
+ * TransCacheUnpinAll if the pin budget allows. Other rows are held to the
+ * table's quota and reservation, and ways reserved for other tables are
+ * skipped.
+ *
+ * Returns TRANS_EMBED_CACHE_MISS for rows which can't be cached, rows of
+ * bypassed tables, rows of tables at their quota with no row of their own to
+ * replace, and rows which lose admission against a victim.
+ */
+unsigned int TransCacheInsert(unsigned int tableID, unsigned int rowID, unsigned int rowBytes, unsigned int pin)
+{
+	unsigned int set = TransCacheSet(tableID, rowID);
+	unsigned int sizeClass = TransCacheClass(rowBytes);
+	struct transEmbedCacheTag* tag = transCacheTags->tag[set];
+	struct transCacheTableStats* share;
+	unsigned int freq, unit, steps, atQuota;
+	int way;
+
+	if (tableID >= TRANS_EMBED_CACHE_TABLE_NUM || sizeClass == TRANS_EMBED_CACHE_CLASS_NUM)
+		return TRANS_EMBED_CACHE_MISS;
+
+	share = &transCacheTags->table[tableID];
+	atQuota = !pin && share->quota != TRANS_EMBED_CACHE_NO_QUOTA && share->units + (1 << sizeClass) > share->quota;
+
+	if (pin || share->units < share->reserved)
+		freq = TRANS_ADMIT_COUNTER_MAX + 1;
+	else if (share->bypassWindows)
+	{
+		transStats->cache_bypasses++;
+		return TRANS_EMBED_CACHE_MISS;
+	}
+	else
+		freq = TransAdmitFrequency(tableID, rowID);
+
+	way = TransCacheFindWay(set, tableID, rowID);
+	if (way >= 0)
+	{
+		if (TransCacheUnitClass(tag[way].unit) == sizeClass)
+		{
+			tag[way].ref = 1;
+			if (pin)
+				TransCachePinTag(set, &tag[way]);
+			return tag[way].unit;
+		}
+	}
+	else if (atQuota)
+	{
+		// Only a row of its own, preferably one not referenced lately
+		int own = -1;
+		for (way = 0; way < TRANS_EMBED_CACHE_WAYS; way++)
+			if (TransCacheTagLive(&tag[way]) && tag[way].tableID == tableID && !tag[way].pinned &&
+					(own < 0 || tag[own].ref))
+				own = way;
+		if (own < 0)
+		{
+			transStats->cache_quota_rejects++;
+			return TRANS_EMBED_CACHE_MISS;
+		}
+		way = own;
+
+		if (TransAdmitFrequency(tag[way].tableID, TransCacheTagRow(set, &tag[way])) >= freq)
+		{
+			transStats->cache_rejections++;
+			return TRANS_EMBED_CACHE_MISS;
+		}
+	}
+	else
+	{
+		for (way = 0; way < TRANS_EMBED_CACHE_WAYS; way++)
+			if (!TransCacheTagLive(&tag[way]))
+				break;
+
+		if (way == TRANS_EMBED_CACHE_WAYS)
+		{
+			for (steps = 0; ; steps++)
+			{
+				if (steps == 2 * TRANS_EMBED_CACHE_WAYS)
+					return TRANS_EMBED_CACHE_MISS;
+				way = transCacheTags->clockHand[set];
+				transCacheTags->clockHand[set] = (way + 1) % TRANS_EMBED_CACHE_WAYS;
+				if (tag[way].pinned || TransCacheReserved(&tag[way], tableID))
+					continue;
+				if (!tag[way].ref)
+					break;
+				tag[way].ref = 0;
+			}
+
+			if (TransAdmitFrequency(tag[way].tableID, TransCacheTagRow(set, &tag[way])) >= freq)
+			{
+				transStats->cache_rejections++;
+				return TRANS_EMBED_CACHE_MISS;
+			}
+		}
+	}
+
+	unit = TransCacheAllocUnit(sizeClass, freq, tableID);
+	if (unit == TRANS_EMBED_CACHE_MISS)
+		return TRANS_EMBED_CACHE_MISS;
+
+	// The slot may have come from this way's own row
+	if (tag[way].valid)
+	{
+		if (TransCacheTagLive(&tag[way]) && (tag[way].keyLow != TransCacheKeyLow(tableID, rowID) || tag[way].tableID != tableID))
+			transStats->cache_evictions++;
+		TransCacheDropTag(&tag[way]);
+	}
+
+	tag[way].unit = unit;
+	tag[way].keyLow = TransCacheKeyLow(tableID, rowID);
+	tag[way].tableID = tableID;
+	tag[way].gen = TransCacheGen(tableID);
+	share->units += 1 << sizeClass;
+	tag[way].valid = 1;
+	tag[way].ref = 1;
+	transCacheTags->owner[tag[way].unit] = set * TRANS_EMBED_CACHE_WAYS + way;
+	if (pin)
+		TransCachePinTag(set, &tag[way]);
+
+	return tag[way].unit;
+}
+
+/*
+ * Pin a row which is already cached. Returns 0 if the row isn't cached and has
+ * to be inserted with pin set.
+ */
+unsigned int TransCachePin(unsigned int tableID, unsigned int rowID, unsigned int rowBytes)
+{
+	unsigned int set = TransCacheSet(tableID, rowID);
+	int way;
+
+	if (tableID >= TRANS_EMBED_CACHE_TABLE_NUM)
+		return 0;
+
+	way = TransCacheFindWay(set, tableID, rowID);
+	if (way < 0 || TransCacheUnitClass(transCacheTags->tag[set][way].unit) != TransCacheClass(rowBytes))
+		return 0;
+
+	TransCachePinTag(set, &transCacheTags->tag[set][way]);
+	return 1;
+}
+
+// Whether a row is cached, without counting a lookup
+unsigned int TransCacheCached(unsigned int tableID, unsigned int rowID, unsigned int rowBytes)
+{
+	unsigned int set = TransCacheSet(tableID, rowID);
+	int way;
+
+	if (tableID >= TRANS_EMBED_CACHE_TABLE_NUM)
+		return 0;
+
+	way = TransCacheFindWay(set, tableID, rowID);
+	return way >= 0 && TransCacheUnitClass(transCacheTags->tag[set][way].unit) == TransCacheClass(rowBytes);
+}
+
+/*
+ * Key of the row held by tag index (set * ways + way) and its admission count,
+ * or -1 if the tag holds no live row. Used to checkpoint the cache.
+ */
+int TransCacheRowAt(unsigned int index, unsigned int* tableID, unsigned int* rowID)
+{
+	struct transEmbedCacheTag* tag = &transCacheTags->tag[index / TRANS_EMBED_CACHE_WAYS][index % TRANS_EMBED_CACHE_WAYS];
+
+	if (!TransCacheTagLive(tag))
+		return -1;
+
+	*tableID = tag->tableID;
+	*rowID = TransCacheTagRow(index / TRANS_EMBED_CACHE_WAYS, tag);
+	return TransAdmitFrequency(*tableID, *rowID);
+}
+
+void TransCacheUnpinAll()
+{
+	unsigned int set, way;
+
+	for (set = 0; set < TRANS_EMBED_CACHE_SET_NUM; set++)
+		for (way = 0; way < TRANS_EMBED_CACHE_WAYS; way++)
+			if (transCacheTags->tag[set][way].valid && transCacheTags->tag[set][way].pinned)
+				TransCacheUnpinTag(&transCacheTags->tag[set][way]);
+}
+
+// Drop the OCM copies of a table's rows, or of all rows for TRANS_EMBED_CACHE_TABLE_NUM
+static void TransCacheL1Invalidate(unsigned int tableID)
+{
+	struct transEmbedL1Tag* tag;
+	unsigned int set, way;
+
+	for (set = 0; set < TRANS_EMBED_L1_SET_NUM; set++)
+		for (way = 0; way < TRANS_EMBED_L1_WAYS; way++)
+		{
+			tag = &transCacheL1->tag[set][way];
+			if (!tag->units || (tableID != TRANS_EMBED_CACHE_TABLE_NUM && tag->tableID != tableID))
+				continue;
+			transCacheL1->owner[tag->unit] = TRANS_EMBED_L1_NO_OWNER;
+			tag->units = 0;
+		}
+}
+
+static void TransCacheBumpEpoch()
+{
+	unsigned int set, way;
+
+	if (++transCacheTags->epochBumps < TRANS_EMBED_CACHE_EPOCH_SWEEP)
+		return;
+
+	for (set = 0; set < TRANS_EMBED_CACHE_SET_NUM; set++)
+		for (way = 0; way < TRANS_EMBED_CACHE_WAYS; way++)
+			if (transCacheTags->tag[set][way].valid && !TransCacheTagLive(&transCacheTags->tag[set][way]))
+				TransCacheDropTag(&transCacheTags->tag[set][way]);
+	transCacheTags->epochBumps = 0;
+}
+
+/*
+ * Invalidate every cached row, e.g. on an NVMe reset. Popularity in the
+ * admission sketch is kept, it describes the workload rather than the rows.
+ */
+void TransCacheInvalidate()
+{
+	unsigned int i;
+
+	transCacheTags->epoch++;
+	TransCacheBumpEpoch();
+	for (i = 0; i < TRANS_EMBED_CACHE_TABLE_NUM; i++)
+	{
+		transCacheTags->table[i].lookups = 0;
+		transCacheTags->table[i].hits = 0;
+		transCacheTags->table[i].bypassWindows = 0;
+		transCacheTags->table[i].units = 0;
+		transCacheTags->table[i].pinnedRows = 0;
+		transCacheTags->table[i].pinnedBytes = 0;
+	}
+	transCacheTags->pinnedRows = 0;
+	transCacheTags->pinnedBytes = 0;
+	TransCacheL1Invalidate(TRANS_EMBED_CACHE_TABLE_NUM);
+}
+
+// Invalidate the cached rows of one table, after it was rewritten or re-registered
+void TransCacheInvalidateTable(unsigned int tableID)
+{
+	if (tableID >= TRANS_EMBED_CACHE_TABLE_NUM)
+		return;
+
+	transCacheTags->tableEpoch[tableID]++;
+	TransCacheBumpEpoch();
+	transCacheTags->table[tableID].lookups = 0;
+	transCacheTags->table[tableID].hits = 0;
+	transCacheTags->table[tableID].bypassWindows = 0;
+	transCacheTags->table[tableID].units = 0;
+	transCacheTags->pinnedRows -= transCacheTags->table[tableID].pinnedRows;
+	transCacheTags->pinnedBytes -= transCacheTags->table[tableID].pinnedBytes;
+	transCacheTags->table[tableID].pinnedRows = 0;
+	transCacheTags->table[tableID].pinnedBytes = 0;
+	TransCacheL1Invalidate(tableID);
+}
+
+/*
+ * Set a table's quota and reservation, quotaKB 0 for no quota. Returns 0 if
+ * the reservation exceeds the quota or the reservations of all tables would
+ * exceed TRANS_EMBED_CACHE_RESERVE_UNITS, leaving them unchanged.
+ */
+unsigned int TransCacheSetQuota(unsigned int tableID, unsigned int quotaKB, unsigned int reservedKB)
+{
+	struct transCacheTableStats* share;
+	unsigned int unitsPerKB = 1024 / TRANS_EMBED_CACHE_UNIT_SIZE;
+	unsigned int quota, reserved;
+
+	if (tableID >= TRANS_EMBED_CACHE_TABLE_NUM ||
+			quotaKB > TRANS_EMBED_CACHE_UNIT_NUM / unitsPerKB || reservedKB > TRANS_EMBED_CACHE_RESERVE_UNITS / unitsPerKB)
+		return 0;
+	share = &transCacheTags->table[tableID];
+	quota = quotaKB ? quotaKB * unitsPerKB : TRANS_EMBED_CACHE_NO_QUOTA;
+	reserved = reservedKB * unitsPerKB;
+	if (reserved > quota || transCacheTags->reservedUnits - share->reserved + reserved > TRANS_EMBED_CACHE_RESERVE_UNITS)
+		return 0;
+
+	transCacheTags->reservedUnits += reserved - share->reserved;
+	share->quota = quota;
+	share->reserved = reserved;
+	return 1;
+}
+
+void TransCachePrintStats()
+{
+	unsigned int sizeClass, tableID, unitsPerKB = 1024 / TRANS_EMBED_CACHE_UNIT_SIZE;
+	struct transCacheTableStats* share;
+
+	xil_printf("Embedding Cache Slabs (free %d/%d), %d pinned rows (%d KB):\r\n", transCacheTags->freeSlabs,
+			TRANS_EMBED_CACHE_SLAB_NUM, transCacheTags->pinnedRows, transCacheTags->pinnedBytes / 1024);
+	for (sizeClass = 0; sizeClass < TRANS_EMBED_CACHE_CLASS_NUM; sizeClass++)
+		if (transCacheTags->sizeClass[sizeClass].slabs)
+			xil_printf("  %dB rows: %d KB in %d slabs, %d rows\r\n",
+					TRANS_EMBED_CACHE_UNIT_SIZE << sizeClass,
+					transCacheTags->sizeClass[sizeClass].slabs * (TRANS_EMBED_CACHE_SLAB_SIZE / 1024),
+					transCacheTags->sizeClass[sizeClass].slabs,
+					transCacheTags->sizeClass[sizeClass].rows);
+	for (tableID = 0; tableID < TRANS_EMBED_CACHE_TABLE_NUM; tableID++)
+	{
+		share = &transCacheTags->table[tableID];
+		if (share->units || share->totalLookups)
+			xil_printf("  table %d: %d KB cached (quota %d KB, reserved %d KB), %d%% of %d lookups hit\r\n", tableID,
+					share->units / unitsPerKB, share->quota == TRANS_EMBED_CACHE_NO_QUOTA ? 0 : share->quota / unitsPerKB,
+					share->reserved / unitsPerKB,
+					share->totalLookups ? (int)((double)share->totalHits * 100 / share->totalLookups) : 0,
+					share->totalLookups);
+		if (share->bypassWindows)
+			xil_printf("  table %d bypassed for %d windows\r\n", tableID, share->bypassWindows);
+	}
+}
+
+/*
+ * Boot self check of the partitioning, on the empty cache right after
+ * TransCacheInit. Fills a table to its quota, checks a further row is
+ * rejected, then that inserts succeed again once the table is invalidated,
+ * and that a pin of the old rows no longer counts against the pin budget.
+ * Leaves the cache as TransCacheInit does.
+ */
+void TransCacheSelfTest()
+{
+	unsigned int tableID = TRANS_EMBED_CACHE_TABLE_NUM - 1;
+	unsigned int quotaUnits = 1024 / TRANS_EMBED_CACHE_UNIT_SIZE;
+	unsigned int rowID;
+
+	ASSERT(TransCacheSetQuota(tableID, 1, 0));
+	for (rowID = 0; rowID < quotaUnits; rowID++)
+		ASSERT(TransCacheInsert(tableID, rowID, TRANS_EMBED_CACHE_UNIT_SIZE, 0) != TRANS_EMBED_CACHE_MISS);
+	ASSERT(transCacheTags->table[tableID].units == quotaUnits);
+	ASSERT(TransCacheInsert(tableID, rowID, TRANS_EMBED_CACHE_UNIT_SIZE, 0) == TRANS_EMBED_CACHE_MISS);
+	ASSERT(TransCachePin(tableID, 0, TRANS_EMBED_CACHE_UNIT_SIZE) && transCacheTags->pinnedRows == 1);
+
+	TransCacheInvalidateTable(tableID);
+	ASSERT(transCacheTags->table[tableID].units == 0);
+	ASSERT(transCacheTags->pinnedRows == 0 && transCacheTags->pinnedBytes == 0);
+	for (rowID = quotaUnits; rowID < 2 * quotaUnits; rowID++)
+		ASSERT(TransCacheInsert(tableID, rowID, TRANS_EMBED_CACHE_UNIT_SIZE, 0) != TRANS_EMBED_CACHE_MISS);
+	ASSERT(transCacheTags->table[tableID].units == quotaUnits);
+	ASSERT(TransCachePin(tableID, quotaUnits, TRANS_EMBED_CACHE_UNIT_SIZE) &&
+			transCacheTags->pinnedBytes == TRANS_EMBED_CACHE_UNIT_SIZE);
+
+	TransCacheInit();
+	transStats->cache_quota_rejects = 0;
+	xil_printf("Embedding cache self test passed\r\n");
+}
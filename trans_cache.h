@@ -0,0 +1,221 @@
+// Harvard University, VLSI-Arch Lab
+// Set-associative embedding row cache
+
+#ifndef TRANS_CACHE_H_
+#define TRANS_CACHE_H_
+
+/*
+ * Rows are cached in their stored format under their full (tableID, rowID)
+ * key. Keys live in a separate tag array so a probe touches one 64B set of
+ * tags and only a hit touches the data array. Replacement within a set is
+ * CLOCK. TRANS_EMBED_CACHE_WAYS 1 gives a direct-mapped index for comparison.
+ *
+ * The row is hashed to a 32 bit key, one to one for a given table, whose top
+ * bits index the set. A tag keeps only the key bits below the set index, the
+ * rowID is recovered from them and the set (see TransCacheTagRow).
+ */
+#define TRANS_EMBED_CACHE_WAYS 8
+#define TRANS_EMBED_CACHE_SET_BITS 17
+#define TRANS_EMBED_CACHE_SET_NUM (1 << TRANS_EMBED_CACHE_SET_BITS)
+#define TRANS_EMBED_CACHE_ENTRY_NUM (TRANS_EMBED_CACHE_SET_NUM * TRANS_EMBED_CACHE_WAYS) // 2^20
+#define TRANS_EMBED_CACHE_KEY_LOW_BITS (32 - TRANS_EMBED_CACHE_SET_BITS)
+#define TRANS_EMBED_CACHE_TABLE_NUM 256
+
+/*
+ * Row data is kept slab style. The data array is cut into 64KB slabs, each
+ * slab holds rows of one size class (power of two from 64B to 4KB, a table's
+ * rows go to the smallest class that fits them). Slabs are handed to classes
+ * on demand, so capacity is shared in bytes. A class below its fair share of
+ * slabs (total / classes in use) takes a slab from the largest class before
+ * it evicts its own rows. Within a class rows are replaced by CLOCK over its
+ * slots, sharing the reference bit with the tag.
+ *
+ * Rows are addressed in 64B units of the data array.
+ */
+#define TRANS_EMBED_CACHE_SIZE (128 * 1024 * 1024)
+#define TRANS_EMBED_CACHE_SLAB_SIZE (64 * 1024)
+#define TRANS_EMBED_CACHE_SLAB_NUM (TRANS_EMBED_CACHE_SIZE / TRANS_EMBED_CACHE_SLAB_SIZE)
+#define TRANS_EMBED_CACHE_UNIT_SIZE 64
+#define TRANS_EMBED_CACHE_UNIT_NUM (TRANS_EMBED_CACHE_SIZE / TRANS_EMBED_CACHE_UNIT_SIZE)
+#define TRANS_EMBED_CACHE_UNITS_PER_SLAB (TRANS_EMBED_CACHE_SLAB_SIZE / TRANS_EMBED_CACHE_UNIT_SIZE)
+#define TRANS_EMBED_CACHE_CLASS_NUM 7 // 64B .. 4KB
+#define TRANS_EMBED_CACHE_MAX_ROW_BYTES (TRANS_EMBED_CACHE_UNIT_SIZE << (TRANS_EMBED_CACHE_CLASS_NUM - 1))
+
+/*
+ * TinyLFU admission. Every lookup is counted in a count-min sketch, whose
+ * counters are halved after TRANS_ADMIT_SAMPLE_SIZE lookups so popularity
+ * decays. A missed row only replaces a victim row which is less popular.
+ */
+#define TRANS_ADMIT_SKETCH_DEPTH 4
+#define TRANS_ADMIT_SKETCH_WIDTH_BITS 18
+#define TRANS_ADMIT_SKETCH_WIDTH (1 << TRANS_ADMIT_SKETCH_WIDTH_BITS)
+#define TRANS_ADMIT_SAMPLE_SIZE (8 * TRANS_ADMIT_SKETCH_WIDTH)
+#define TRANS_ADMIT_COUNTER_MAX 15
+
+/*
+ * Tables whose hit rate over a window of lookups stays below the threshold
+ * stop inserting rows for the next TRANS_BYPASS_WINDOWS windows, then get a
+ * trial window with inserts again.
+ */
+#define TRANS_BYPASS_WINDOW 65536
+#define TRANS_BYPASS_HIT_PERCENT 2
+#define TRANS_BYPASS_WINDOWS 16
+
+/*
+ * Rows preloaded by the host (IO_NVM_EMBED_PRELOAD) are pinned. At most half
+ * of the data array and WAYS - 1 ways of a set can be pinned, so unpinned rows
+ * always find a victim. Slabs holding pinned rows are never moved.
+ */
+#define TRANS_EMBED_CACHE_PIN_BYTES (TRANS_EMBED_CACHE_SIZE / 2)
+
+/*
+ * Per-table partitioning, set at runtime (ADMIN_EMBED_TABLE_CACHE_QUOTA).
+ * A table at its quota only replaces its own rows in the set of the new row,
+ * otherwise the row isn't cached. Rows of a table at or below its reservation
+ * are skipped by the replacement of other tables, and while below it the
+ * table's rows skip admission and the bypass. Reservations may add up to half
+ * of the data array. Slabs moved between size classes drop their rows
+ * whatever the reservations. Pinned rows have their own budget and ignore
+ * quotas. Occupancy is counted in 64B units.
+ */
+#define TRANS_EMBED_CACHE_NO_QUOTA 0xffffffff
+#define TRANS_EMBED_CACHE_RESERVE_UNITS (TRANS_EMBED_CACHE_UNIT_NUM / 2)
+
+/*
+ * L1 tier in on-chip RAM. The lower 192KB of OCM (ps7_ram_0) hold the firmware
+ * image, the upper 64KB (ps7_ram_1, less the 512B the boot ROM keeps) are free.
+ * Rows hit in the DRAM cache whose admission count reaches
+ * TRANS_EMBED_L1_PROMOTE_FREQ are copied there, and lookups probe it first.
+ * Row data is a log of 64B units overwritten oldest first, keys are kept in a
+ * small 2-way index with LRU.
+ */
+#define TRANS_EMBED_L1_SIZE 0xFE00
+#define TRANS_EMBED_L1_UNIT_NUM 896 // 56KB
+#define TRANS_EMBED_L1_SET_BITS 8
+#define TRANS_EMBED_L1_SET_NUM (1 << TRANS_EMBED_L1_SET_BITS)
+#define TRANS_EMBED_L1_WAYS 2
+#define TRANS_EMBED_L1_MAX_ROW_BYTES 1024
+#define TRANS_EMBED_L1_PROMOTE_FREQ 12
+#define TRANS_EMBED_L1_NO_OWNER 0xffff
+
+/*
+ * Invalidation is lazy. Each tag keeps the generation it was filled under, the
+ * sum of a global epoch and its table's epoch, so bumping either makes rows
+ * stale. Stale rows miss and give up their way and slot when an insert or the
+ * CLOCK hand runs over them. Generations are 16 bits wide; after
+ * TRANS_EMBED_CACHE_EPOCH_SWEEP bumps, stale tags are dropped in one sweep
+ * before a generation can repeat. The OCM tier is small enough to clear
+ * right away.
+ */
+#define TRANS_EMBED_CACHE_GEN_MASK 0xffff
+#define TRANS_EMBED_CACHE_EPOCH_SWEEP TRANS_EMBED_CACHE_GEN_MASK
+
+#define TRANS_EMBED_CACHE_MISS 0xffffffff
+#define TRANS_EMBED_CACHE_NO_OWNER 0xffffffff
+#define TRANS_EMBED_CACHE_FREE_SLAB 0xff
+
+// 8B, a set of 8 ways is one 64B line
+struct transEmbedCacheTag {
+	unsigned int keyLow : TRANS_EMBED_CACHE_KEY_LOW_BITS; // key bits below the set index
+	unsigned int valid : 1;
+	unsigned int gen : 16; // stale unless TransCacheGen(tableID)
+	unsigned int tableID : 8;
+	unsigned int ref : 1; // CLOCK reference bit
+	unsigned int unit : 21; // first 64B unit of the row in the data array
+	unsigned int pinned : 1; // preloaded by the host, never replaced
+};
+
+struct transEmbedCacheClass {
+	unsigned int slabs;
+	unsigned int rows;
+	unsigned int clockUnit;
+};
+
+struct transAdmitSketch {
+	unsigned char counter[TRANS_ADMIT_SKETCH_DEPTH][TRANS_ADMIT_SKETCH_WIDTH];
+	unsigned int samples;
+};
+
+struct transCacheTableStats {
+	unsigned int lookups;
+	unsigned int hits;
+	unsigned int bypassWindows; // windows left without inserts
+
+	// Partitioning, in units
+	unsigned int units; // occupied by live rows
+	unsigned int quota;
+	unsigned int reserved;
+
+	// Live pinned rows, given back to the pin budget when the table is invalidated
+	unsigned int pinnedRows;
+	unsigned int pinnedBytes;
+
+	// Since boot, for reporting
+	unsigned int totalLookups;
+	unsigned int totalHits;
+};
+
+struct transEmbedCacheTagArray {
+	struct transEmbedCacheTag tag[TRANS_EMBED_CACHE_SET_NUM][TRANS_EMBED_CACHE_WAYS];
+	unsigned char clockHand[TRANS_EMBED_CACHE_SET_NUM];
+
+	// Slab bookkeeping
+	unsigned int owner[TRANS_EMBED_CACHE_UNIT_NUM]; // unit -> tag index (set * ways + way)
+	unsigned char slabClass[TRANS_EMBED_CACHE_SLAB_NUM];
+	unsigned short slabPins[TRANS_EMBED_CACHE_SLAB_NUM]; // pinned tags, stale ones until unpinned
+	unsigned int freeSlabs;
+	unsigned int pinnedRows; // live ones only
+	unsigned int pinnedBytes;
+	unsigned int reservedUnits; // sum of the table reservations
+	struct transEmbedCacheClass sizeClass[TRANS_EMBED_CACHE_CLASS_NUM];
+
+	// Admission
+	struct transAdmitSketch sketch;
+	struct transCacheTableStats table[TRANS_EMBED_CACHE_TABLE_NUM];
+
+	// Invalidation
+	unsigned int epoch;
+	unsigned short tableEpoch[TRANS_EMBED_CACHE_TABLE_NUM];
+	unsigned int epochBumps; // since the last sweep
+};
+
+struct transEmbedCache {
+	unsigned char slab[TRANS_EMBED_CACHE_SLAB_NUM][TRANS_EMBED_CACHE_SLAB_SIZE];
+};
+
+struct transEmbedL1Tag {
+	unsigned int rowID;
+	unsigned short unit; // first 64B unit of the row in the L1 data array
+	unsigned char tableID;
+	unsigned char units; // row size in units, 0 if the way is invalid
+};
+
+struct transEmbedL1 {
+	unsigned char data[TRANS_EMBED_L1_UNIT_NUM][TRANS_EMBED_CACHE_UNIT_SIZE];
+	struct transEmbedL1Tag tag[TRANS_EMBED_L1_SET_NUM][TRANS_EMBED_L1_WAYS];
+	unsigned short owner[TRANS_EMBED_L1_UNIT_NUM]; // first unit of a row -> tag index (set * ways + way)
+	unsigned char lru[TRANS_EMBED_L1_SET_NUM]; // way to replace next
+	unsigned short head; // next unit of the log to write
+};
+
+extern struct transEmbedCacheTagArray* transCacheTags;
+extern struct transEmbedCache* transCache;
+extern struct transEmbedL1* transCacheL1;
+
+// Cache line (unit) -> row bytes
+#define TRANS_CACHE_ROW(line) ((unsigned char*)transCache + (line) * TRANS_EMBED_CACHE_UNIT_SIZE)
+
+void TransCacheInit();
+const unsigned char* TransCacheLookup(unsigned int tableID, unsigned int rowID, unsigned int rowBytes);
+unsigned int TransCacheInsert(unsigned int tableID, unsigned int rowID, unsigned int rowBytes, unsigned int pin);
+unsigned int TransCachePin(unsigned int tableID, unsigned int rowID, unsigned int rowBytes);
+unsigned int TransCacheCached(unsigned int tableID, unsigned int rowID, unsigned int rowBytes);
+int TransCacheRowAt(unsigned int index, unsigned int* tableID, unsigned int* rowID);
+void TransCacheUnpinAll();
+void TransCacheInvalidate();
+void TransCacheInvalidateTable(unsigned int tableID);
+unsigned int TransCacheSetQuota(unsigned int tableID, unsigned int quotaKB, unsigned int reservedKB);
+void TransCachePrintStats();
+void TransCacheSelfTest();
+
+#endif /* TRANS_CACHE_H_ */
@@ -0,0 +1,452 @@
+// Harvard University, VLSI-Arch Lab
+// Pooling kernels for the embedding translation engine
+
+#include	"xil_printf.h"
+#include	"xtime_l.h"
+#include	"trans_kernel.h"
+#include	<float.h>
+
+#if defined(TRANS_KERNEL_NEON)
+#include	<arm_neon.h>
+#elif defined(TRANS_KERNEL_AVX)
+#include	<immintrin.h>
+#elif defined(TRANS_KERNEL_SSE)
+#include	<emmintrin.h>
+#endif
+
+/*
+ * 4 lane helpers for the quantized formats. fp16 is only converted in vector
+ * registers when the FPU has the half precision extension (neon-fp16, F16C).
+ */
+#if defined(TRANS_KERNEL_NEON)
+#define TRANS_KERNEL_VEC4 1
+#if defined(__ARM_FP) && (__ARM_FP & 0x2)
+#define TRANS_KERNEL_VEC4_FP16 1
+#endif
+typedef float32x4_t TransVec4;
+#define Vec4Load(p)				vld1q_f32(p)
+#define Vec4Store(p, v)			vst1q_f32(p, v)
+#define Vec4Dup(x)				vdupq_n_f32(x)
+#define Vec4Add(a, b)			vaddq_f32(a, b)
+#define Vec4Max(a, b)			vmaxq_f32(a, b)
+#define Vec4Mla(a, b, c)		vmlaq_f32(a, b, c)
+#elif defined(TRANS_KERNEL_SSE) && defined(__SSE2__)
+#define TRANS_KERNEL_VEC4 1
+#if defined(TRANS_KERNEL_AVX) && defined(__F16C__)
+#define TRANS_KERNEL_VEC4_FP16 1
+#endif
+typedef __m128 TransVec4;
+#define Vec4Load(p)				_mm_loadu_ps(p)
+#define Vec4Store(p, v)			_mm_storeu_ps(p, v)
+#define Vec4Dup(x)				_mm_set1_ps(x)
+#define Vec4Add(a, b)			_mm_add_ps(a, b)
+#define Vec4Max(a, b)			_mm_max_ps(a, b)
+#define Vec4Mla(a, b, c)		_mm_add_ps(a, _mm_mul_ps(b, c))
+#endif
+
+#define TRANS_KERNEL_INLINE static inline __attribute__((always_inline))
+
+/*
+ * Base loops. These are always inlined into the specialized kernels below, so
+ * with a constant embedding length the compiler fully unrolls them.
+ *
+ * Embeddings are only 4B aligned in both flash pages and the scratchpad, and
+ * rows are read straight from the page buffers, which stay strongly-ordered
+ * and fault on unaligned accesses, so only element aligned vector accesses
+ * are used.
+ */
+TRANS_KERNEL_INLINE void PoolSumFp32(float* toAtr, const float* fromAtr, unsigned int n)
+{
+	unsigned int k = 0;
+#if defined(TRANS_KERNEL_NEON)
+	for (; k + 4 <= n; k += 4)
+		vst1q_f32(toAtr + k, vaddq_f32(vld1q_f32(toAtr + k), vld1q_f32(fromAtr + k)));
+#else
+#if defined(TRANS_KERNEL_AVX)
+	for (; k + 8 <= n; k += 8)
+		_mm256_storeu_ps(toAtr + k, _mm256_add_ps(_mm256_loadu_ps(toAtr + k), _mm256_loadu_ps(fromAtr + k)));
+#endif
+#if defined(TRANS_KERNEL_SSE)
+	for (; k + 4 <= n; k += 4)
+		_mm_storeu_ps(toAtr + k, _mm_add_ps(_mm_loadu_ps(toAtr + k), _mm_loadu_ps(fromAtr + k)));
+#endif
+#endif
+	for (; k < n; k++)
+		toAtr[k] += fromAtr[k];
+}
+
+TRANS_KERNEL_INLINE void PoolMaxFp32(float* toAtr, const float* fromAtr, unsigned int n)
+{
+	unsigned int k = 0;
+#if defined(TRANS_KERNEL_NEON)
+	for (; k + 4 <= n; k += 4)
+		vst1q_f32(toAtr + k, vmaxq_f32(vld1q_f32(toAtr + k), vld1q_f32(fromAtr + k)));
+#else
+#if defined(TRANS_KERNEL_AVX)
+	for (; k + 8 <= n; k += 8)
+		_mm256_storeu_ps(toAtr + k, _mm256_max_ps(_mm256_loadu_ps(toAtr + k), _mm256_loadu_ps(fromAtr + k)));
+#endif
+#if defined(TRANS_KERNEL_SSE)
+	for (; k + 4 <= n; k += 4)
+		_mm_storeu_ps(toAtr + k, _mm_max_ps(_mm_loadu_ps(toAtr + k), _mm_loadu_ps(fromAtr + k)));
+#endif
+#endif
+	for (; k < n; k++)
+		toAtr[k] = (fromAtr[k] > toAtr[k]) ? fromAtr[k] : toAtr[k];
+}
+
+TRANS_KERNEL_INLINE void PoolAxpyFp32(float* toAtr, const float* fromAtr, unsigned int n, float weight)
+{
+	unsigned int k = 0;
+#if defined(TRANS_KERNEL_NEON)
+	for (; k + 4 <= n; k += 4)
+		vst1q_f32(toAtr + k, vmlaq_n_f32(vld1q_f32(toAtr + k), vld1q_f32(fromAtr + k), weight));
+#else
+#if defined(TRANS_KERNEL_AVX)
+	__m256 w8 = _mm256_set1_ps(weight);
+	for (; k + 8 <= n; k += 8)
+		_mm256_storeu_ps(toAtr + k, _mm256_add_ps(_mm256_loadu_ps(toAtr + k),
+				_mm256_mul_ps(_mm256_loadu_ps(fromAtr + k), w8)));
+#endif
+#if defined(TRANS_KERNEL_SSE)
+	__m128 w4 = _mm_set1_ps(weight);
+	for (; k + 4 <= n; k += 4)
+		_mm_storeu_ps(toAtr + k, _mm_add_ps(_mm_loadu_ps(toAtr + k),
+				_mm_mul_ps(_mm_loadu_ps(fromAtr + k), w4)));
+#endif
+#endif
+	for (; k < n; k++)
+		toAtr[k] += weight * fromAtr[k];
+}
+
+TRANS_KERNEL_INLINE void CopyFp32(float* toAtr, const float* fromAtr, unsigned int n)
+{
+	unsigned int k = 0;
+#if defined(TRANS_KERNEL_NEON)
+	for (; k + 4 <= n; k += 4)
+		vst1q_f32(toAtr + k, vld1q_f32(fromAtr + k));
+#elif defined(TRANS_KERNEL_SSE)
+	for (; k + 4 <= n; k += 4)
+		_mm_storeu_ps(toAtr + k, _mm_loadu_ps(fromAtr + k));
+#endif
+	for (; k < n; k++)
+		toAtr[k] = fromAtr[k];
+}
+
+/*
+ * Quantized formats, see TransRowBytes for the row layouts. Dequantization is
+ * fused into the pooling loop, the row is never expanded to fp32 in memory.
+ */
+TRANS_KERNEL_INLINE float HalfToFloat(unsigned short h)
+{
+	union { unsigned int u; float f; } v;
+	unsigned int sign = (h & 0x8000) << 16;
+	unsigned int exp = (h >> 10) & 0x1f;
+	unsigned int mant = h & 0x3ff;
+
+	if (exp == 0x1f)
+		v.u = sign | 0x7f800000 | (mant << 13);
+	else if (exp)
+		v.u = sign | ((exp + 112) << 23) | (mant << 13);
+	else
+	{
+		// zero or subnormal, mant * 2^-24
+		v.f = (float)mant * (1.0f / 16777216.0f);
+		v.u |= sign;
+	}
+	return v.f;
+}
+
+#if defined(TRANS_KERNEL_VEC4_FP16)
+TRANS_KERNEL_INLINE TransVec4 LoadFp16x4(const unsigned short* fromAtr)
+{
+#if defined(TRANS_KERNEL_NEON)
+	return vcvt_f32_f16(vreinterpret_f16_u16(vld1_u16(fromAtr)));
+#else
+	return _mm_cvtph_ps(_mm_loadl_epi64((const __m128i*)fromAtr));
+#endif
+}
+#endif
+
+#if defined(TRANS_KERNEL_VEC4)
+// scale * q + bias for 4 int8 codes
+TRANS_KERNEL_INLINE TransVec4 LoadInt8x4(const signed char* fromAtr, TransVec4 scale, TransVec4 bias)
+{
+#if defined(TRANS_KERNEL_NEON)
+	int32x4_t q = vmovl_s16(vget_low_s16(vmovl_s8(vreinterpret_s8_u32(vld1_dup_u32((const uint32_t*)fromAtr)))));
+	return vmlaq_f32(bias, vcvtq_f32_s32(q), scale);
+#else
+	int word;
+	__builtin_memcpy(&word, fromAtr, sizeof(word));
+	__m128i q = _mm_cvtsi32_si128(word);
+	q = _mm_unpacklo_epi8(q, q);
+	q = _mm_srai_epi32(_mm_unpacklo_epi16(q, q), 24);
+	return _mm_add_ps(bias, _mm_mul_ps(_mm_cvtepi32_ps(q), scale));
+#endif
+}
+#endif
+
+TRANS_KERNEL_INLINE void PoolAxpyFp16(float* toAtr, const unsigned short* fromAtr, unsigned int n, float weight)
+{
+	unsigned int k = 0;
+#if defined(TRANS_KERNEL_VEC4_FP16)
+	TransVec4 w4 = Vec4Dup(weight);
+	for (; k + 4 <= n; k += 4)
+		Vec4Store(toAtr + k, Vec4Mla(Vec4Load(toAtr + k), LoadFp16x4(fromAtr + k), w4));
+#endif
+	for (; k < n; k++)
+		toAtr[k] += weight * HalfToFloat(fromAtr[k]);
+}
+
+TRANS_KERNEL_INLINE void PoolMaxFp16(float* toAtr, const unsigned short* fromAtr, unsigned int n)
+{
+	unsigned int k = 0;
+	float atr;
+#if defined(TRANS_KERNEL_VEC4_FP16)
+	for (; k + 4 <= n; k += 4)
+		Vec4Store(toAtr + k, Vec4Max(Vec4Load(toAtr + k), LoadFp16x4(fromAtr + k)));
+#endif
+	for (; k < n; k++)
+	{
+		atr = HalfToFloat(fromAtr[k]);
+		toAtr[k] = (atr > toAtr[k]) ? atr : toAtr[k];
+	}
+}
+
+/*
+ * int8 rows carry their own fp32 scale and bias behind the codes. For the
+ * additive operators the weight is folded into them, so every attribute costs
+ * one multiply-add: to += (w * scale) * q + (w * bias).
+ */
+TRANS_KERNEL_INLINE void PoolAxpyInt8(float* toAtr, const signed char* fromAtr, unsigned int n, float weight)
+{
+	const float* scaleBias = (const float*)(fromAtr + TRANS_INT8_CODE_BYTES(n));
+	float scale = weight * scaleBias[0];
+	float bias = weight * scaleBias[1];
+	unsigned int k = 0;
+#if defined(TRANS_KERNEL_VEC4)
+	TransVec4 scale4 = Vec4Dup(scale), bias4 = Vec4Dup(bias);
+	for (; k + 4 <= n; k += 4)
+		Vec4Store(toAtr + k, Vec4Add(Vec4Load(toAtr + k), LoadInt8x4(fromAtr + k, scale4, bias4)));
+#endif
+	for (; k < n; k++)
+		toAtr[k] += scale * fromAtr[k] + bias;
+}
+
+TRANS_KERNEL_INLINE void PoolMaxInt8(float* toAtr, const signed char* fromAtr, unsigned int n)
+{
+	const float* scaleBias = (const float*)(fromAtr + TRANS_INT8_CODE_BYTES(n));
+	float scale = scaleBias[0];
+	float bias = scaleBias[1];
+	float atr;
+	unsigned int k = 0;
+#if defined(TRANS_KERNEL_VEC4)
+	TransVec4 scale4 = Vec4Dup(scale), bias4 = Vec4Dup(bias);
+	for (; k + 4 <= n; k += 4)
+		Vec4Store(toAtr + k, Vec4Max(Vec4Load(toAtr + k), LoadInt8x4(fromAtr + k, scale4, bias4)));
+#endif
+	for (; k < n; k++)
+	{
+		atr = scale * fromAtr[k] + bias;
+		toAtr[k] = (atr > toAtr[k]) ? atr : toAtr[k];
+	}
+}
+
+/*
+ * Kernel instantiation. The specialized lengths must stay in sync with
+ * transKernelLength[] and TRANS_KERNEL_LENGTH_NUM. LEN is 0 for the generic
+ * kernel, which uses the runtime embedding length.
+ */
+#define TRANS_KERNEL_FP32(SUFFIX, LEN)																		\
+static void PoolSumFp32_##SUFFIX(float* toAtr, const void* fromAtr, unsigned int embeddingLength, float weight)	\
+{																											\
+	PoolSumFp32(toAtr, (const float*)fromAtr, LEN ? LEN : embeddingLength);									\
+}																											\
+static void PoolMaxFp32_##SUFFIX(float* toAtr, const void* fromAtr, unsigned int embeddingLength, float weight)	\
+{																											\
+	PoolMaxFp32(toAtr, (const float*)fromAtr, LEN ? LEN : embeddingLength);									\
+}																											\
+static void PoolAxpyFp32_##SUFFIX(float* toAtr, const void* fromAtr, unsigned int embeddingLength, float weight)	\
+{																											\
+	PoolAxpyFp32(toAtr, (const float*)fromAtr, LEN ? LEN : embeddingLength, weight);						\
+}																											\
+static void CopyFp32_##SUFFIX(void* toAtr, const void* fromAtr, unsigned int embeddingLength)					\
+{																											\
+	CopyFp32((float*)toAtr, (const float*)fromAtr, LEN ? LEN : embeddingLength);							\
+}
+
+/* Rows are padded to 4B, so the cache copy moves whole words of the stored row. */
+#define TRANS_KERNEL_FP16(SUFFIX, LEN)																		\
+static void PoolSumFp16_##SUFFIX(float* toAtr, const void* fromAtr, unsigned int embeddingLength, float weight)	\
+{																											\
+	PoolAxpyFp16(toAtr, (const unsigned short*)fromAtr, LEN ? LEN : embeddingLength, 1.0f);					\
+}																											\
+static void PoolMaxFp16_##SUFFIX(float* toAtr, const void* fromAtr, unsigned int embeddingLength, float weight)	\
+{																											\
+	PoolMaxFp16(toAtr, (const unsigned short*)fromAtr, LEN ? LEN : embeddingLength);							\
+}																											\
+static void PoolAxpyFp16_##SUFFIX(float* toAtr, const void* fromAtr, unsigned int embeddingLength, float weight)	\
+{																											\
+	PoolAxpyFp16(toAtr, (const unsigned short*)fromAtr, LEN ? LEN : embeddingLength, weight);				\
+}																											\
+static void CopyFp16_##SUFFIX(void* toAtr, const void* fromAtr, unsigned int embeddingLength)					\
+{																											\
+	CopyFp32((float*)toAtr, (const float*)fromAtr,															\
+			TransRowBytes(TRANS_ATTR_FP16, LEN ? LEN : embeddingLength) / sizeof(float));					\
+}
+
+#define TRANS_KERNEL_INT8(SUFFIX, LEN)																		\
+static void PoolSumInt8_##SUFFIX(float* toAtr, const void* fromAtr, unsigned int embeddingLength, float weight)	\
+{																											\
+	PoolAxpyInt8(toAtr, (const signed char*)fromAtr, LEN ? LEN : embeddingLength, 1.0f);					\
+}																											\
+static void PoolMaxInt8_##SUFFIX(float* toAtr, const void* fromAtr, unsigned int embeddingLength, float weight)	\
+{																											\
+	PoolMaxInt8(toAtr, (const signed char*)fromAtr, LEN ? LEN : embeddingLength);							\
+}																											\
+static void PoolAxpyInt8_##SUFFIX(float* toAtr, const void* fromAtr, unsigned int embeddingLength, float weight)	\
+{																											\
+	PoolAxpyInt8(toAtr, (const signed char*)fromAtr, LEN ? LEN : embeddingLength, weight);					\
+}																											\
+static void CopyInt8_##SUFFIX(void* toAtr, const void* fromAtr, unsigned int embeddingLength)					\
+{																											\
+	CopyFp32((float*)toAtr, (const float*)fromAtr,															\
+			TransRowBytes(TRANS_ATTR_INT8, LEN ? LEN : embeddingLength) / sizeof(float));					\
+}
+
+#define TRANS_KERNEL_TYPE(TYPE)	\
+	TYPE(4, 4)					\
+	TYPE(8, 8)					\
+	TYPE(16, 16)				\
+	TYPE(32, 32)				\
+	TYPE(64, 64)				\
+	TYPE(128, 128)				\
+	TYPE(N, 0)
+
+TRANS_KERNEL_TYPE(TRANS_KERNEL_FP32)
+TRANS_KERNEL_TYPE(TRANS_KERNEL_FP16)
+TRANS_KERNEL_TYPE(TRANS_KERNEL_INT8)
+
+static const unsigned int transKernelLength[TRANS_KERNEL_LENGTH_NUM] = {4, 8, 16, 32, 64, 128};
+
+#define TRANS_KERNEL_ROW(POOL, IDENTITY, NAME, TYPE)											\
+	{																						\
+		{POOL##TYPE##_4, Copy##TYPE##_4, IDENTITY, NAME "/4"},								\
+		{POOL##TYPE##_8, Copy##TYPE##_8, IDENTITY, NAME "/8"},								\
+		{POOL##TYPE##_16, Copy##TYPE##_16, IDENTITY, NAME "/16"},							\
+		{POOL##TYPE##_32, Copy##TYPE##_32, IDENTITY, NAME "/32"},							\
+		{POOL##TYPE##_64, Copy##TYPE##_64, IDENTITY, NAME "/64"},							\
+		{POOL##TYPE##_128, Copy##TYPE##_128, IDENTITY, NAME "/128"},						\
+		{POOL##TYPE##_N, Copy##TYPE##_N, IDENTITY, NAME "/N"},								\
+	}
+
+static const struct transKernel transKernelTable[TRANS_POOL_OP_NUM][TRANS_ATTR_TYPE_NUM][TRANS_KERNEL_LENGTH_NUM + 1] = {
+	{ // TRANS_POOL_SUM
+		TRANS_KERNEL_ROW(PoolSum, 0.0f, "sum/fp32", Fp32),
+		TRANS_KERNEL_ROW(PoolSum, 0.0f, "sum/fp16", Fp16),
+		TRANS_KERNEL_ROW(PoolSum, 0.0f, "sum/int8", Int8),
+	},
+	{ // TRANS_POOL_MEAN
+		TRANS_KERNEL_ROW(PoolSum, 0.0f, "mean/fp32", Fp32),
+		TRANS_KERNEL_ROW(PoolSum, 0.0f, "mean/fp16", Fp16),
+		TRANS_KERNEL_ROW(PoolSum, 0.0f, "mean/int8", Int8),
+	},
+	{ // TRANS_POOL_MAX
+		TRANS_KERNEL_ROW(PoolMax, -FLT_MAX, "max/fp32", Fp32),
+		TRANS_KERNEL_ROW(PoolMax, -FLT_MAX, "max/fp16", Fp16),
+		TRANS_KERNEL_ROW(PoolMax, -FLT_MAX, "max/int8", Int8),
+	},
+	{ // TRANS_POOL_WEIGHTED_SUM
+		TRANS_KERNEL_ROW(PoolAxpy, 0.0f, "wsum/fp32", Fp32),
+		TRANS_KERNEL_ROW(PoolAxpy, 0.0f, "wsum/fp16", Fp16),
+		TRANS_KERNEL_ROW(PoolAxpy, 0.0f, "wsum/int8", Int8),
+	},
+};
+
+unsigned int TransAttributeType(unsigned int attributeSize)
+{
+	if (attributeSize == 4)
+		return TRANS_ATTR_FP32;
+	if (attributeSize == 2)
+		return TRANS_ATTR_FP16;
+	if (attributeSize == 1)
+		return TRANS_ATTR_INT8;
+
+	xil_printf("Unsupported attribute size: %d\r\n", attributeSize);
+	return TRANS_ATTR_TYPE_NUM;
+}
+
+unsigned int TransRowBytes(unsigned int attributeType, unsigned int embeddingLength)
+{
+	if (attributeType == TRANS_ATTR_FP16)
+		return (embeddingLength * 2 + 3) & ~0x3;
+	if (attributeType == TRANS_ATTR_INT8)
+		return TRANS_INT8_CODE_BYTES(embeddingLength) + 2 * sizeof(float);
+	return embeddingLength * sizeof(float);
+}
+
+const struct transKernel* SelectTransKernel(unsigned int poolOperator, unsigned int attributeType, unsigned int embeddingLength)
+{
+	unsigned int i;
+
+	if (poolOperator >= TRANS_POOL_OP_NUM || attributeType >= TRANS_ATTR_TYPE_NUM)
+		return 0;
+
+	for (i = 0; i < TRANS_KERNEL_LENGTH_NUM; i++)
+		if (transKernelLength[i] == embeddingLength)
+			break;
+
+	return &transKernelTable[poolOperator][attributeType][i];
+}
+
+/*
+ * Microbenchmark. Pools every row of the source buffer into one result, for
+ * every kernel variant, and reports the bandwidth of pooled input.
+ *
+ * srcBuf/dstBuf must be scratch DRAM which is not in use (e.g. the
+ * translation scratchpads before the host is up).
+ */
+#define TRANS_KERNEL_BENCH_ITERS 16
+
+void TransKernelBenchmark(void* srcBuf, void* dstBuf, unsigned int bufSize)
+{
+	unsigned int op, type, len, row, iter, rows, embeddingLength, rowBytes;
+	XTime start, end;
+	unsigned char* src = (unsigned char*)srcBuf;
+	float* dst = (float*)dstBuf;
+
+	// 0x3c bytes are small finite values in every format, no denormals or NaNs
+	for (row = 0; row < bufSize; row++)
+		src[row] = 0x3c;
+
+	xil_printf("Translation kernel benchmark (%d KB input)\r\n", bufSize / 1024);
+	for (op = 0; op < TRANS_POOL_OP_NUM; op++)
+	{
+		for (type = 0; type < TRANS_ATTR_TYPE_NUM; type++)
+		{
+			for (len = 0; len <= TRANS_KERNEL_LENGTH_NUM; len++)
+			{
+				const struct transKernel* kernel = &transKernelTable[op][type][len];
+				// Generic kernel is measured with an unspecialized length
+				embeddingLength = (len < TRANS_KERNEL_LENGTH_NUM) ? transKernelLength[len] : 24;
+				rowBytes = TransRowBytes(type, embeddingLength);
+				rows = bufSize / rowBytes;
+
+				for (row = 0; row < embeddingLength; row++)
+					dst[row] = kernel->identity;
+
+				XTime_GetTime(&start);
+				for (iter = 0; iter < TRANS_KERNEL_BENCH_ITERS; iter++)
+					for (row = 0; row < rows; row++)
+						kernel->pool(dst, src + row * rowBytes, embeddingLength, 0.5f);
+				XTime_GetTime(&end);
+
+				// bytes / us = MB/s
+				unsigned long long bytes = (unsigned long long)TRANS_KERNEL_BENCH_ITERS * rows * rowBytes;
+				unsigned long long us = ((end - start) * 1000000) / COUNTS_PER_SECOND;
+				unsigned long long mbps = us ? (bytes / us) : 0;
+				xil_printf("  %s: %d.%03d GB/s\r\n", kernel->name, (unsigned int)(mbps / 1000), (unsigned int)(mbps % 1000));
+			}
+		}
+	}
+}
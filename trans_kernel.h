@@ -0,0 +1,77 @@
+// Harvard University, VLSI-Arch Lab
+// Pooling kernels for the embedding translation engine
+
+#ifndef TRANS_KERNEL_H_
+#define TRANS_KERNEL_H_
+
+/*
+ * SIMD selection. The A9 build gets NEON (-mfpu=neon), a host build of the
+ * kernels gets AVX or SSE. Everything falls back to the scalar loop.
+ */
+#if defined(__ARM_NEON__) || defined(__ARM_NEON)
+#define TRANS_KERNEL_NEON 1
+#elif defined(__AVX__)
+#define TRANS_KERNEL_AVX 1
+#define TRANS_KERNEL_SSE 1
+#elif defined(__SSE__)
+#define TRANS_KERNEL_SSE 1
+#endif
+
+// Pooling operators, see struct transConfig
+#define TRANS_POOL_SUM 0
+#define TRANS_POOL_MEAN 1
+#define TRANS_POOL_MAX 2
+#define TRANS_POOL_WEIGHTED_SUM 3
+#define TRANS_POOL_OP_NUM 4
+
+// Operators which need a per-result pass once all inputs of a result are pooled
+#define TransPoolNeedsFinalize(op) ((op) == TRANS_POOL_MEAN || (op) == TRANS_POOL_MAX)
+
+/*
+ * Attribute types stored in an embedding table, selected by transConfig.attributeSize.
+ * Results are always returned as fp32.
+ *
+ * FP32 (4B): row = float[len]
+ * FP16 (2B): row = IEEE half[len], padded to 4B
+ * INT8 (1B): row = int8 codes[len], padded to 4B, then fp32 scale, fp32 bias.
+ *            Attribute k dequantizes to scale * code[k] + bias.
+ *
+ * Rows never straddle a flash page, a page holds PAGE_SIZE / TransRowBytes() rows.
+ */
+#define TRANS_ATTR_FP32 0
+#define TRANS_ATTR_FP16 1
+#define TRANS_ATTR_INT8 2
+#define TRANS_ATTR_TYPE_NUM 3
+
+#define TRANS_INT8_CODE_BYTES(len) (((len) + 3) & ~0x3)
+
+// Embedding lengths with a compile-time specialized kernel, anything else uses the generic one
+#define TRANS_KERNEL_LENGTH_NUM 6 // 4, 8, 16, 32, 64, 128
+
+/*
+ * A kernel family is specialized per (pooling operator, attribute type,
+ * embedding length) and selected once per request when the config is processed.
+ *
+ * pool: accumulate one input embedding into a fp32 result embedding. weight is
+ *       only used by TRANS_POOL_WEIGHTED_SUM.
+ * copy: copy one input row (in its stored format, TransRowBytes) into the embedding cache.
+ * identity: initial value of every result attribute.
+ *
+ * MEAN accumulates like SUM and is scaled when the result sector is finalized.
+ */
+typedef void (*TransPoolKernel)(float* toAtr, const void* fromAtr, unsigned int embeddingLength, float weight);
+typedef void (*TransCopyKernel)(void* toAtr, const void* fromAtr, unsigned int embeddingLength);
+
+struct transKernel {
+	TransPoolKernel pool;
+	TransCopyKernel copy;
+	float identity;
+	const char* name;
+};
+
+const struct transKernel* SelectTransKernel(unsigned int poolOperator, unsigned int attributeType, unsigned int embeddingLength);
+unsigned int TransAttributeType(unsigned int attributeSize);
+unsigned int TransRowBytes(unsigned int attributeType, unsigned int embeddingLength);
+void TransKernelBenchmark(void* srcBuf, void* dstBuf, unsigned int bufSize);
+
+#endif /* TRANS_KERNEL_H_ */
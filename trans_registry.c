@@ -0,0 +1,99 @@
+// Harvard University, VLSI-Arch Lab
+// Device side registry of embedding tables
+
+#include	"trans_registry.h"
+#include	"trans_kernel.h"
+#include	"memory_map.h"
+#include	"low_level_scheduler.h"
+
+struct transTableRegistry* transTables;
+
+void TransRegistryInit()
+{
+	unsigned int handle;
+
+	transTables = (struct transTableRegistry*)TRANS_REGISTRY_ADDR;
+	for (handle = 0; handle < TRANS_TABLE_NUM; handle++)
+		transTables->table[handle].valid = 0;
+}
+
+/*
+ * (Re)register a table. Returns 0 if a field is out of range or the row
+ * format has no kernel, leaving the registry unchanged.
+ */
+unsigned int TransRegisterTable(unsigned int handle, unsigned int slba, unsigned int rows,
+		unsigned int attributeSize, unsigned int embeddingLength, unsigned int layout,
+		unsigned int cachePolicy, unsigned int idTransform)
+{
+	struct transTableInfo* table;
+	unsigned int attributeType = TransAttributeType(attributeSize);
+	unsigned int rowBytes;
+
+	if (handle >= TRANS_TABLE_NUM || layout >= TRANS_TABLE_LAYOUT_NUM ||
+			cachePolicy >= TRANS_TABLE_CACHE_POLICY_NUM || idTransform >= TRANS_ID_TRANSFORM_NUM ||
+			attributeType == TRANS_ATTR_TYPE_NUM || embeddingLength == 0 ||
+			(idTransform != TRANS_ID_RAW && rows == 0))
+		return 0;
+
+	rowBytes = TransRowBytes(attributeType, embeddingLength);
+	if (rowBytes > PAGE_SIZE || !SelectTransKernel(TRANS_POOL_SUM, attributeType, embeddingLength))
+		return 0;
+
+	table = &transTables->table[handle];
+	table->slba = slba;
+	table->rows = rows;
+	table->attributeSize = attributeSize;
+	table->embeddingLength = embeddingLength;
+	table->idTransform = idTransform;
+	table->cachePolicy = cachePolicy;
+	table->rowBytes = rowBytes;
+	table->rowsPerPage = PAGE_SIZE / rowBytes;
+	table->valid = 1;
+	TransCacheInvalidateTable(handle);
+	TransWarmArm(handle);
+
+	return 1;
+}
+
+void TransUnregisterTable(unsigned int handle)
+{
+	if (handle < TRANS_TABLE_NUM)
+	{
+		transTables->table[handle].valid = 0;
+		TransCacheInvalidateTable(handle);
+		TransWarmDisarm(handle);
+	}
+}
+
+// Registered table of handle, 0 if there is none
+const struct transTableInfo* TransLookupTable(unsigned int handle)
+{
+	if (handle >= TRANS_TABLE_NUM || !transTables->table[handle].valid)
+		return 0;
+
+	return &transTables->table[handle];
+}
+
+/*
+ * Invalidate the cached rows of every table a host write to sectors at lba
+ * overlaps. A raw table without a row count may extend to the end of the drive.
+ */
+void TransTablesWritten(unsigned int lba, unsigned int sectors)
+{
+	struct transTableInfo* table;
+	unsigned int handle, tableSectors;
+
+	for (handle = 0; handle < TRANS_TABLE_NUM; handle++)
+	{
+		table = &transTables->table[handle];
+		if (!table->valid || lba + sectors <= table->slba)
+			continue;
+
+		tableSectors = ((table->rows + table->rowsPerPage - 1) / table->rowsPerPage) * SECTOR_NUM_PER_PAGE;
+		if (table->rows && lba >= table->slba + tableSectors)
+			continue;
+
+		TransCacheInvalidateTable(handle);
+		TransWarmArm(handle);
+	}
+}
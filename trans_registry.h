@@ -0,0 +1,54 @@
+// Harvard University, VLSI-Arch Lab
+// Device side registry of embedding tables
+
+#ifndef TRANS_REGISTRY_H_
+#define TRANS_REGISTRY_H_
+
+/*
+ * Tables are registered once by the host (ADMIN_EMBED_TABLE_REGISTER) under a
+ * handle, which is also the tableID of their rows in the embedding cache.
+ * Translation configs name their table by handle and the device fills in the
+ * table's geometry, so a config carries only the pooling request and its IDs.
+ * The registry is set up at boot and kept across NVMe resets. Re-registering a
+ * table, or writing to its LBAs, invalidates its rows in the embedding cache
+ * and restarts their warm-up from the checkpoint (trans_warm.h).
+ */
+#define TRANS_TABLE_NUM 256 // TRANS_EMBED_CACHE_TABLE_NUM
+
+#define TRANS_TABLE_LAYOUT_PACKED 0 // rows packed per flash page, never straddling two
+#define TRANS_TABLE_LAYOUT_NUM 1
+
+#define TRANS_TABLE_CACHE_DEFAULT 0 // TinyLFU admission and per-table bypass
+#define TRANS_TABLE_CACHE_NONE 1 // rows are always read from flash
+#define TRANS_TABLE_CACHE_POLICY_NUM 2
+
+struct transTableInfo {
+	unsigned int slba;
+	unsigned int rows;
+	unsigned int attributeSize;
+	unsigned int embeddingLength;
+	unsigned int idTransform;
+	unsigned int cachePolicy;
+
+	// Page geometry, precomputed at registration
+	unsigned int rowBytes;
+	unsigned int rowsPerPage;
+
+	unsigned int valid;
+};
+
+struct transTableRegistry {
+	struct transTableInfo table[TRANS_TABLE_NUM];
+};
+
+extern struct transTableRegistry* transTables;
+
+void TransRegistryInit();
+unsigned int TransRegisterTable(unsigned int handle, unsigned int slba, unsigned int rows,
+		unsigned int attributeSize, unsigned int embeddingLength, unsigned int layout,
+		unsigned int cachePolicy, unsigned int idTransform);
+void TransUnregisterTable(unsigned int handle);
+const struct transTableInfo* TransLookupTable(unsigned int handle);
+void TransTablesWritten(unsigned int lba, unsigned int sectors);
+
+#endif /* TRANS_REGISTRY_H_ */
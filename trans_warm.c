@@ -0,0 +1,282 @@
+// Harvard University, VLSI-Arch Lab
+// Embedding cache checkpoint and warm-up across power cycles
+
+#include	"xil_printf.h"
+#include	"string.h"
+#include	"nvme/debug.h"
+#include	"init_ftl.h"
+#include	"page_map.h"
+#include	"trans_warm.h"
+#include	"trans_buffer.h"
+#include	"memory_map.h"
+#include	"low_level_scheduler.h"
+#include	"xil_cache.h"
+
+struct transWarmState* transWarm;
+
+// Dies whose reserved block is good, the checkpoint pages are striped over them
+static unsigned int TransWarmGoodDies()
+{
+	unsigned int dieNo, dies = 0;
+
+	for (dieNo = 0; dieNo < DIE_NUM; dieNo++)
+		if (!blockMap->bmEntry[dieNo][TRANS_WARM_BLOCK_NO].bad)
+			transWarm->goodDie[dies++] = dieNo;
+
+	return dies;
+}
+
+// Queue a read or write of checkpoint page of the image
+static void TransWarmPushPage(unsigned int request, unsigned int page, unsigned int dies)
+{
+	unsigned int dieNo = transWarm->goodDie[page % dies];
+	unsigned int diePpn = TRANS_WARM_BLOCK_NO * PAGE_NUM_PER_SLC_BLOCK + 1 + page / dies;
+
+	PushToSubReqQueue(dieNo % CHANNEL_NUM, dieNo / CHANNEL_NUM, request, diePpn,
+			(unsigned int)&transWarm->image + page * PAGE_SIZE, SPARE_ADDR);
+}
+
+static unsigned int TransWarmPages(unsigned int keyNum)
+{
+	return 1 + TRANS_WARM_SKETCH_PAGES + (keyNum * sizeof(struct transWarmKey) + PAGE_SIZE - 1) / PAGE_SIZE;
+}
+
+/*
+ * Read the checkpoint back at boot, after the bad block table. A missing or
+ * foreign checkpoint leaves the cache cold.
+ */
+void TransWarmInit()
+{
+	struct transWarmHeader* header;
+	unsigned int t, page, pages, dies;
+
+	transWarm = (struct transWarmState*)TRANS_WARM_ADDR;
+	header = &transWarm->image.header;
+
+	for (t = 0; t < TRANS_TABLE_NUM; t++)
+		transWarm->armed[t] = 0;
+	transWarm->armedTables = 0;
+	transWarm->table = 0;
+
+	/*
+	 * The image is cached and NAND DMA bypasses the cache: no line of it may
+	 * be dirty while a page is read in, nor stale once it has been.
+	 */
+	header->magic = 0;
+	Xil_DCacheFlushRange((unsigned int)&transWarm->image, PAGE_SIZE);
+	dies = TransWarmGoodDies();
+	if (dies)
+	{
+		TransWarmPushPage(LLSCommand_ReadLsbPage, 0, dies);
+		EmptyLowLevelQ(SUB_REQ_QUEUE);
+		Xil_DCacheInvalidateRange((unsigned int)&transWarm->image, PAGE_SIZE);
+	}
+
+	if (header->magic != TRANS_WARM_MAGIC || header->dies != dies || header->keyNum > TRANS_WARM_KEY_NUM)
+	{
+		header->keyNum = 0;
+		for (t = 0; t <= TRANS_TABLE_NUM; t++)
+			header->tableStart[t] = 0;
+		xil_printf("[ no embedding cache checkpoint. ]\r\n");
+		return;
+	}
+
+	pages = TransWarmPages(header->keyNum);
+	Xil_DCacheInvalidateRange((unsigned int)&transWarm->image + PAGE_SIZE, (pages - 1) * PAGE_SIZE);
+	for (page = 1; page < pages; page++)
+		TransWarmPushPage(LLSCommand_ReadLsbPage, page, dies);
+	EmptyLowLevelQ(SUB_REQ_QUEUE);
+	Xil_DCacheInvalidateRange((unsigned int)&transWarm->image + PAGE_SIZE, (pages - 1) * PAGE_SIZE);
+
+	memcpy(transCacheTags->sketch.counter, transWarm->image.sketch, TRANS_WARM_SKETCH_BYTES);
+	transCacheTags->sketch.samples = header->sketchSamples;
+
+	xil_printf("[ embedding cache checkpoint: %d rows. ]\r\n", header->keyNum);
+}
+
+/*
+ * Write the keys of the live cached rows and the admission sketch to the
+ * reserved block, on shutdown. If there are more rows than TRANS_WARM_KEY_NUM
+ * the most popular ones are kept. Keys are grouped by table, hottest first.
+ */
+void TransWarmCheckpoint()
+{
+	struct transWarmHeader* header = &transWarm->image.header;
+	unsigned int index, tableID, rowID, t, f, n, room, keyNum, page, pages, dies;
+	int freq;
+
+	dies = TransWarmGoodDies();
+	if (!dies)
+		return;
+
+	for (t = 0; t < TRANS_TABLE_NUM; t++)
+		for (f = 0; f <= TRANS_ADMIT_COUNTER_MAX; f++)
+			transWarm->count[t][f] = 0;
+	for (index = 0; index < TRANS_EMBED_CACHE_ENTRY_NUM; index++)
+	{
+		freq = TransCacheRowAt(index, &tableID, &rowID);
+		if (freq >= 0)
+			transWarm->count[tableID][freq]++;
+	}
+
+	// Keep whole frequencies from the top while they fit, then what is left of the next one
+	room = TRANS_WARM_KEY_NUM;
+	if (TransWarmPages(room) > dies * (PAGE_NUM_PER_SLC_BLOCK - 1))
+		room = ((dies * (PAGE_NUM_PER_SLC_BLOCK - 1) - 1 - TRANS_WARM_SKETCH_PAGES) * PAGE_SIZE) /
+				sizeof(struct transWarmKey);
+	for (f = TRANS_ADMIT_COUNTER_MAX + 1; f-- > 0;)
+		for (t = 0; t < TRANS_TABLE_NUM; t++)
+		{
+			if (transWarm->count[t][f] > room)
+				transWarm->count[t][f] = room;
+			room -= transWarm->count[t][f];
+		}
+
+	// Buckets in key order, count becomes the fill cursor
+	keyNum = 0;
+	for (t = 0; t < TRANS_TABLE_NUM; t++)
+	{
+		header->tableStart[t] = keyNum;
+		for (f = TRANS_ADMIT_COUNTER_MAX + 1; f-- > 0;)
+		{
+			n = transWarm->count[t][f];
+			transWarm->count[t][f] = keyNum;
+			keyNum += n;
+			transWarm->end[t][f] = keyNum;
+		}
+	}
+	header->tableStart[TRANS_TABLE_NUM] = keyNum;
+
+	for (index = 0; index < TRANS_EMBED_CACHE_ENTRY_NUM; index++)
+	{
+		freq = TransCacheRowAt(index, &tableID, &rowID);
+		if (freq < 0)
+			continue;
+
+		n = transWarm->count[tableID][freq];
+		if (n == transWarm->end[tableID][freq])
+			continue;
+		transWarm->image.key[n].rowID = rowID;
+		transWarm->image.key[n].tableID = tableID;
+		transWarm->image.key[n].freq = freq;
+		transWarm->count[tableID][freq]++;
+	}
+
+	header->magic = TRANS_WARM_MAGIC;
+	header->dies = dies;
+	header->keyNum = keyNum;
+	header->sketchSamples = transCacheTags->sketch.samples;
+	memcpy(transWarm->image.sketch, transCacheTags->sketch.counter, TRANS_WARM_SKETCH_BYTES);
+
+	for (page = 0; page < dies; page++)
+		PushToSubReqQueue(transWarm->goodDie[page] % CHANNEL_NUM, transWarm->goodDie[page] / CHANNEL_NUM,
+				V2FCommand_BlockErase, TRANS_WARM_BLOCK_NO * PAGE_NUM_PER_BLOCK, NONE, NONE);
+	pages = TransWarmPages(keyNum);
+	Xil_DCacheFlushRange((unsigned int)&transWarm->image, pages * PAGE_SIZE);
+	for (page = 0; page < pages; page++)
+		TransWarmPushPage(LLSCommand_WriteLsbPage, page, dies);
+	EmptyLowLevelQ(SUB_REQ_QUEUE);
+
+	// The staged keys are the new checkpoint's, warm-ups under way would index them
+	for (t = 0; t < TRANS_TABLE_NUM; t++)
+		TransWarmDisarm(t);
+
+	xil_printf("[ embedding cache checkpoint of %d rows is saved. ]\r\n", keyNum);
+}
+
+// Warm a table's rows from its first key, once it is registered or rewritten
+void TransWarmArm(unsigned int tableID)
+{
+	struct transWarmHeader* header = &transWarm->image.header;
+
+	if (tableID >= TRANS_TABLE_NUM || header->tableStart[tableID] == header->tableStart[tableID + 1])
+		return;
+
+	if (!transWarm->armed[tableID])
+		transWarm->armedTables++;
+	transWarm->armed[tableID] = 1;
+	transWarm->next[tableID] = header->tableStart[tableID];
+}
+
+void TransWarmDisarm(unsigned int tableID)
+{
+	if (tableID >= TRANS_TABLE_NUM || !transWarm->armed[tableID])
+		return;
+
+	transWarm->armed[tableID] = 0;
+	transWarm->armedTables--;
+}
+
+/*
+ * Hand the next batch of an armed table to the translation queue as a
+ * preload which inserts its rows unpinned. Called from the main loop, does
+ * nothing while translations are queued.
+ */
+void TransWarmStep()
+{
+	struct transWarmHeader* header = &transWarm->image.header;
+	const struct transTableInfo* table;
+	struct transPreloadConfig* config;
+	struct transPreloadRow row;
+	unsigned int t, i, j, n, entryIdx;
+
+	if (!transWarm->armedTables)
+		return;
+	if (transRqPointer->head != 0xffff || transReadRqPointer->head != 0xffff || transAdmitQ->count)
+		return;
+
+	for (i = 0; i < TRANS_TABLE_NUM; i++)
+	{
+		t = (transWarm->table + i) % TRANS_TABLE_NUM;
+		if (transWarm->armed[t])
+			break;
+	}
+	transWarm->table = (t + 1) % TRANS_TABLE_NUM;
+
+	table = TransLookupTable(t);
+	if (!table || table->cachePolicy == TRANS_TABLE_CACHE_NONE)
+	{
+		TransWarmDisarm(t);
+		return;
+	}
+
+	n = header->tableStart[t + 1] - transWarm->next[t];
+	if (n > TRANS_WARM_BATCH)
+		n = TRANS_WARM_BATCH;
+	entryIdx = AllocateTransBufEntry(0, TRANS_PRELOAD_REQUEST_ID, 0,
+			TRANS_PRELOAD_HEADER_SIZE + n * sizeof(struct transPreloadRow));
+	if (entryIdx == 0xffff)
+		return;
+
+	config = (struct transPreloadConfig*)transMap->bufEntry[entryIdx].configAddr;
+	config->flags = TRANS_PRELOAD_WARM;
+	config->tableNum = 1;
+	config->table[0].tableID = t;
+	config->table[0].slba = table->slba;
+	config->table[0].attributeSize = table->attributeSize;
+	config->table[0].embeddingLength = table->embeddingLength;
+
+	// Insertion sort by row, so rows of a page share its read
+	config->rowNum = 0;
+	for (i = transWarm->next[t]; i < transWarm->next[t] + n; i++)
+	{
+		row.tableID = t;
+		row.rowID = transWarm->image.key[i].rowID;
+		if (table->rows && row.rowID >= table->rows)
+			continue;
+		for (j = config->rowNum; j > 0 && config->rowList[j - 1].rowID > row.rowID; j--)
+			config->rowList[j] = config->rowList[j - 1];
+		config->rowList[j] = row;
+		config->rowNum++;
+	}
+
+	transWarm->next[t] += n;
+	if (transWarm->next[t] == header->tableStart[t + 1])
+		TransWarmDisarm(t);
+
+	transMap->bufEntry[entryIdx].preload = 1;
+	transMap->bufEntry[entryIdx].rxDmaExe = 0;
+	XTime_GetTime(&transMap->bufEntry[entryIdx].configWriteRequested);
+	PushToTransReqQueue(entryIdx);
+	reservedReq = 1;
+}
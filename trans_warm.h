@@ -0,0 +1,81 @@
+// Harvard University, VLSI-Arch Lab
+// Embedding cache checkpoint and warm-up across power cycles
+
+#ifndef TRANS_WARM_H_
+#define TRANS_WARM_H_
+
+#include "init_ftl.h"
+#include "trans_cache.h"
+#include "trans_registry.h"
+
+/*
+ * On shutdown the keys of the cached rows, hottest first, and the admission
+ * sketch are written to a reserved physical block of every die (LSB pages,
+ * striped over the dies like the bad block table is kept per die). The block
+ * is kept out of the FTL like the metadata block.
+ *
+ * On boot the checkpoint is read back: the sketch is restored right away and
+ * the keys are grouped by table. The FTL formats the drive at boot, so a
+ * table's rows are warmed once the host registers the table again, and again
+ * from its first key whenever it is rewritten. Warm-up runs in the
+ * background: a batch of TRANS_WARM_BATCH rows of one table is handed to the
+ * translation queue as an internal preload (TRANS_PRELOAD_WARM), only while
+ * no translation is queued.
+ */
+#define TRANS_WARM_BLOCK_NO 1 // physical block per die, next to the metadata block
+#define TRANS_WARM_MAGIC 0x5741524d
+#define TRANS_WARM_KEY_NUM (512 * 1024)
+#define TRANS_WARM_SKETCH_BYTES (TRANS_ADMIT_SKETCH_DEPTH * TRANS_ADMIT_SKETCH_WIDTH)
+#define TRANS_WARM_SKETCH_PAGES (TRANS_WARM_SKETCH_BYTES / PAGE_SIZE)
+#define TRANS_WARM_KEY_PAGES ((TRANS_WARM_KEY_NUM * 8) / PAGE_SIZE)
+#define TRANS_WARM_PAGES (1 + TRANS_WARM_SKETCH_PAGES + TRANS_WARM_KEY_PAGES) // header page first
+#define TRANS_WARM_BATCH 256
+
+struct transWarmKey {
+	unsigned int rowID;
+	unsigned int tableID : 8;
+	unsigned int freq : 8;
+	unsigned int reserved : 16;
+};
+
+struct transWarmHeader {
+	unsigned int magic;
+	unsigned int dies; // dies the pages were striped over
+	unsigned int keyNum;
+	unsigned int sketchSamples;
+	unsigned int tableStart[TRANS_TABLE_NUM + 1]; // keys of a table are [tableStart[t], tableStart[t + 1])
+};
+
+// Staged in flash page layout
+struct transWarmImage {
+	union {
+		struct transWarmHeader header;
+		unsigned char page[PAGE_SIZE];
+	};
+	unsigned char sketch[TRANS_WARM_SKETCH_BYTES];
+	struct transWarmKey key[TRANS_WARM_KEY_NUM];
+};
+
+struct transWarmState {
+	struct transWarmImage image;
+
+	unsigned int next[TRANS_TABLE_NUM]; // next key of a table to warm
+	unsigned int armed[TRANS_TABLE_NUM];
+	unsigned int armedTables;
+	unsigned int table; // round robin over armed tables
+
+	// Checkpoint staging, keys per (table, frequency)
+	unsigned int count[TRANS_TABLE_NUM][TRANS_ADMIT_COUNTER_MAX + 1];
+	unsigned int end[TRANS_TABLE_NUM][TRANS_ADMIT_COUNTER_MAX + 1];
+	unsigned char goodDie[DIE_NUM];
+};
+
+extern struct transWarmState* transWarm;
+
+void TransWarmInit();
+void TransWarmCheckpoint();
+void TransWarmArm(unsigned int tableID);
+void TransWarmDisarm(unsigned int tableID);
+void TransWarmStep();
+
+#endif /* TRANS_WARM_H_ */